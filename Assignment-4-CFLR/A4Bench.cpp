@@ -0,0 +1,239 @@
+/**
+ * A4Bench.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <random>
+#include <tuple>
+
+/*
+ * Scaling benchmark of the parallel worklist engine: solves one graph with 1, 2, 4, ... and N threads.
+ *
+ *   a4bench [--threads=N] [--nodes=V] [--objects=M] [--degree=D] [--seed=X] [--reps=R] [--format=json|csv]
+ *           [<input-bitcode>]
+ *
+ * With a bitcode file (e.g. a program of Test-Cases, compiled with clang -S -emit-llvm), the graph is the PAG
+ * of that program; otherwise it is a synthetic PAG of V variables and M objects, where one variable in four
+ * takes the address of an object and every variable has D random copy, store or load edges.
+ * One thread is the serial engine, the baseline of the speedups. Each thread count runs R times; one record
+ * per thread count holds the minimum and median time of solve. The checksum of the PT relation must agree
+ * between all thread counts.
+ */
+
+namespace
+{
+
+struct BenchConfig
+{
+    unsigned threads = 4;
+    unsigned nodes = 20000;
+    unsigned objects = 1000;
+    unsigned degree = 2;
+    unsigned seed = 1;
+    unsigned reps = 3;
+    std::string format = "json";
+    std::string input;
+};
+
+struct Record
+{
+    unsigned threads;
+    double minNs;
+    double medianNs;
+    size_t ptEdges;
+    uint64_t checksum;
+};
+
+/// Add a PAG edge and its reverse, which is labelled with the next label
+void addPagEdge(CFLRGraph &graph, unsigned src, unsigned dst, EdgeLabel label)
+{
+    graph.addEdge(src, dst, label);
+    graph.addEdge(dst, src, label + 1);
+}
+
+CFLRGraph *makeGraph(const BenchConfig &config)
+{
+    auto graph = new CFLRGraph;
+    std::mt19937 rng(config.seed);
+    auto randomNode = [&]() { return (unsigned) (rng() % config.nodes); };
+
+    // objects are numbered after the variables
+    for (unsigned n = 0; n < config.nodes; n += 4)
+        addPagEdge(*graph, config.nodes + rng() % config.objects, n, Addr);
+
+    for (unsigned n = 0; n < config.nodes; ++n)
+    {
+        for (unsigned d = 0; d < config.degree; ++d)
+        {
+            unsigned kind = rng() % 10;
+            unsigned other = randomNode();
+            if (kind < 6)
+                addPagEdge(*graph, n, other, Copy);
+            else if (kind < 8)
+                addPagEdge(*graph, n, other, Store);
+            else
+                addPagEdge(*graph, n, other, Load);
+        }
+    }
+    return graph;
+}
+
+/// Number and order-independent hash of the PT edges
+std::pair<size_t, uint64_t> summarize(const CFLRGraph &graph)
+{
+    size_t edges = 0;
+    uint64_t checksum = 0;
+    for (unsigned src = 0; src < graph.getNumIndices(); ++src)
+    {
+        graph.getSuccessors(src, PT).forEach([&](unsigned dst) {
+            edges++;
+            checksum += mixEdgeKey(CFLREdge(graph.getNode(src), graph.getNode(dst), PT).pack());
+        });
+    }
+    return {edges, checksum};
+}
+
+Record measure(const BenchConfig &config, const CFLRGraph &base, unsigned threads)
+{
+    Record record{threads, 0, 0, 0, 0};
+    std::vector<double> times;
+    for (unsigned rep = 0; rep < config.reps; ++rep)
+    {
+        CFLR solver;
+        solver.setEngine("worklist");
+        solver.setThreads(threads);
+        solver.setGraph(new CFLRGraph(base));
+
+        auto start = std::chrono::steady_clock::now();
+        solver.solve();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+
+        std::tie(record.ptEdges, record.checksum) = summarize(*solver.getGraph());
+    }
+    std::sort(times.begin(), times.end());
+    record.minNs = times.front();
+    record.medianNs = times[times.size() / 2];
+    return record;
+}
+
+bool parseArgs(int argc, char **argv, BenchConfig &config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            if (!config.input.empty())
+                return false;
+            config.input = arg;
+            continue;
+        }
+        auto eq = arg.find('=');
+        if (eq == std::string::npos)
+            return false;
+        std::string name = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+
+        if (name == "format")
+            config.format = value;
+        else
+        {
+            char *end;
+            unsigned long number = std::strtoul(value.c_str(), &end, 10);
+            if (end == value.c_str() || *end != '\0' || number > UINT_MAX)
+                return false;
+            // a seed may be zero, and so may the degree (no edges but the Addr ones); counts may not
+            if (number == 0 && name != "seed" && name != "degree")
+                return false;
+            if (name == "threads")
+                config.threads = number;
+            else if (name == "nodes")
+                config.nodes = number;
+            else if (name == "objects")
+                config.objects = number;
+            else if (name == "degree")
+                config.degree = number;
+            else if (name == "seed")
+                config.seed = number;
+            else if (name == "reps")
+                config.reps = number;
+            else
+                return false;
+        }
+    }
+    return config.format == "json" || config.format == "csv";
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config))
+    {
+        std::cerr << "usage: a4bench [--threads=N] [--nodes=V] [--objects=M] [--degree=D] [--seed=X] [--reps=R] "
+                     "[--format=json|csv] [<input-bitcode>]\n";
+        return 1;
+    }
+
+    CFLRGraph *base;
+    std::string graphName = "synthetic";
+    if (config.input.empty())
+        base = makeGraph(config);
+    else
+    {
+        SVF::LLVMModuleSet::buildSVFModule({config.input});
+        SVF::SVFIRBuilder builder;
+        base = new CFLRGraph(builder.build());
+        graphName = config.input;
+    }
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < config.threads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(config.threads);
+
+    std::vector<Record> records;
+    for (auto threads : threadCounts)
+    {
+        records.push_back(measure(config, *base, threads));
+        if (records.back().checksum != records.front().checksum || records.back().ptEdges != records.front().ptEdges)
+        {
+            std::cerr << "PT relation with " << threads << " threads differs from the one of the serial engine\n";
+            return 1;
+        }
+    }
+
+    // one JSON object per line, or CSV with a header row
+    if (config.format == "csv")
+        std::cout << "graph,nodes,threads,reps,min_ns,median_ns,speedup,pt_edges,checksum\n";
+    for (auto &record : records)
+    {
+        double speedup = records.front().minNs / record.minNs;
+        if (config.format == "csv")
+        {
+            std::cout << graphName << "," << base->getNumIndices() << "," << record.threads << "," << config.reps
+                      << "," << (uint64_t) record.minNs << "," << (uint64_t) record.medianNs << "," << speedup
+                      << "," << record.ptEdges << "," << record.checksum << "\n";
+        }
+        else
+        {
+            std::cout << "{\"graph\": \"" << graphName << "\", \"nodes\": " << base->getNumIndices()
+                      << ", \"threads\": " << record.threads << ", \"reps\": " << config.reps
+                      << ", \"min_ns\": " << (uint64_t) record.minNs << ", \"median_ns\": "
+                      << (uint64_t) record.medianNs << ", \"speedup\": " << speedup << ", \"pt_edges\": "
+                      << record.ptEdges << ", \"checksum\": " << record.checksum << "}\n";
+        }
+    }
+    delete base;
+    SVF::LLVMModuleSet::releaseLLVMModuleSet();
+    return 0;
+}
@@ -9,6 +9,9 @@
 #include <utility>
 
 #include "SVF-LLVM/SVFIRBuilder.h"
+#include "AdjacencyRow.h"
+#include "BitMatrix.h"
+#include "CFLGrammar.h"
 
 using EdgeLabel = unsigned;
 
@@ -27,6 +30,44 @@ enum EdgeLabelType
     LV, LVBar,
 };
 
+constexpr unsigned NUM_EDGE_LABELS = LVBar + 1;
+using Grammar = CFLGrammar<NUM_EDGE_LABELS>;
+
+/**
+ * Field-insensitive pointer analysis, normalized. An edge PT(p, o) means p points to o; PTBar(o, p) is its
+ * reverse, i.e. the value of o flows to p. SV and LV are the intermediate labels of the store and load rules:
+ *   PTBar ::= Addr | PTBar Copy | PTBar Store PT | PTBar PTBar Load
+ * (a value stored through a pointer to o flows into o; a load through a pointer to o reads from o),
+ * and PT mirrors each PTBar rule with the reversed labels.
+ */
+inline constexpr Production pointerProductions[] = {
+        {PTBar, Addr, Production::NO_LABEL},
+        {PT, AddrBar, Production::NO_LABEL},
+        {PTBar, PTBar, Copy},
+        {PT, CopyBar, PT},
+        {SV, Store, PT},            // SV(q, o): q is stored into o
+        {SVBar, PTBar, StoreBar},
+        {PTBar, PTBar, SV},
+        {PT, SVBar, PT},
+        {LV, PTBar, Load},          // LV(o, q): o is loaded into q
+        {LVBar, LoadBar, PT},
+        {PTBar, PTBar, LV},
+        {PT, LVBar, PT},
+};
+inline constexpr Grammar pointerGrammar = Grammar::build(pointerProductions);
+
+
+/// Scramble the bits of a packed edge key, so that keys differing in any field land far apart
+inline uint64_t mixEdgeKey(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
 
 /**
  * The edge type of CFL-reachability
@@ -52,6 +93,24 @@ struct CFLREdge
     {
         return (src == rhs.src) && (dst == rhs.dst) && (label == rhs.label);
     }
+
+    /// Bits of the label and of each node in a packed edge
+    static constexpr unsigned LABEL_BITS = 6;
+    static constexpr unsigned NODE_BITS = 29;
+    static_assert(NUM_EDGE_LABELS <= (1u << LABEL_BITS), "too many labels for a packed edge");
+
+    /// The edge as one 64-bit key: src, dst, label from the high bits down
+    inline uint64_t pack() const
+    {
+        assert(src < (1u << NODE_BITS) && dst < (1u << NODE_BITS) && "node too large for a packed edge");
+        return ((uint64_t) src << (NODE_BITS + LABEL_BITS)) | ((uint64_t) dst << LABEL_BITS) | label;
+    }
+
+    static inline CFLREdge unpack(uint64_t key)
+    {
+        return CFLREdge(key >> (NODE_BITS + LABEL_BITS), (key >> LABEL_BITS) & ((1u << NODE_BITS) - 1),
+                        key & ((1u << LABEL_BITS) - 1));
+    }
 };
 
 
@@ -59,30 +118,36 @@ template<>
 struct std::hash<CFLREdge>
 {
     size_t operator()(const CFLREdge &edge) const
-    { return ((uint64_t) edge.src << 32) | (uint64_t) edge.dst; }
+    { return mixEdgeKey(edge.pack()); }
 };
 
 
 /**
  * The graph for CFL-reachability-based pointer analysis
+ *
+ * Nodes are renumbered densely in the order they are first seen. The edges are stored label-major: for each
+ * label, one row of successors and one row of predecessors per node index, as an AdjacencyRow. The solver
+ * works on node indices and joins whole rows instead of single edges.
  */
 class CFLRGraph
 {
 public:
-    /// We use a source -> label -> target map to represent the adjacency list of the predecessors/successors of nodes.
-    using DataMap = std::unordered_map<unsigned, std::unordered_map<EdgeLabel, std::unordered_set<unsigned>>>;
+    static constexpr unsigned NO_INDEX = ~0u;
+
+    /// Construct an empty graph, to be filled with addEdge
+    CFLRGraph() = default;
 
     /// Construct a graph from a PAG
     explicit CFLRGraph(SVF::SVFIR *pag);
 
     /**
-     * Check whether an edge is already in the graph
+     * Check whether an edge is already in the graph; never allocates
      * @param src the source node of the edge
      * @param dst the target node of the edge
      * @param label the label of the edge
      * @return true of the edge already exists, false otherwise
      */
-    bool hasEdge(unsigned src, unsigned dst, EdgeLabel label);
+    bool hasEdge(unsigned src, unsigned dst, EdgeLabel label) const;
 
     /**
      * Add an edge to the graph
@@ -92,15 +157,131 @@ public:
      */
     void addEdge(unsigned src, unsigned dst, EdgeLabel label);
 
-    DataMap &getSuccessorMap()
-    { return succMap; }
+    /// Number of node indices
+    inline unsigned getNumIndices() const
+    { return nodeOf.size(); }
 
-    DataMap &getPredecessorMap()
-    { return predMap; }
+    /// Index of a node, NO_INDEX if the node has no edge
+    inline unsigned getIndex(unsigned node) const
+    { return node < indexOf.size() ? indexOf[node] : NO_INDEX; }
 
-protected:
-    DataMap predMap;   // holding predecessors
-    DataMap succMap;   // holding successors
+    /// Node of an index
+    inline unsigned getNode(unsigned index) const
+    { return nodeOf[index]; }
+
+    /// Successors of index through label, as indices
+    inline const AdjacencyRow &getSuccessors(unsigned index, EdgeLabel label) const
+    { return rowOf(succ[label], index); }
+
+    /// Predecessors of index through label, as indices
+    inline const AdjacencyRow &getPredecessors(unsigned index, EdgeLabel label) const
+    { return rowOf(pred[label], index); }
+
+    /**
+     * Add an edge between two indices
+     * @return true if the edge was not in the graph
+     */
+    bool addIndexEdge(unsigned src, unsigned dst, EdgeLabel label);
+
+    /**
+     * head(src, x) for each right(mid, x): add the successors of mid through right to the ones of src through
+     * head, appending the new ones to added
+     */
+    void joinSuccessors(unsigned src, EdgeLabel head, unsigned mid, EdgeLabel right, std::vector<unsigned> &added);
+
+    /**
+     * head(x, dst) for each left(x, mid): add the predecessors of mid through left to the ones of dst through
+     * head, appending the new ones to added
+     */
+    void joinPredecessors(unsigned dst, EdgeLabel head, unsigned mid, EdgeLabel left, std::vector<unsigned> &added);
+
+    /// Number of edges labelled label
+    size_t getNumEdges(EdgeLabel label) const;
+
+    /// Bytes held by the successor and predecessor rows of label
+    size_t getMemoryBytes(EdgeLabel label) const;
+
+    static const char *getLabelName(EdgeLabel label);
+
+private:
+    using Rows = std::vector<AdjacencyRow>;
+
+    inline static const AdjacencyRow &rowOf(const Rows &rows, unsigned index)
+    {
+        static const AdjacencyRow empty;
+        return index < rows.size() ? rows[index] : empty;
+    }
+
+    /// Row of index, the rows growing to hold it
+    inline static AdjacencyRow &rowAt(Rows &rows, unsigned index)
+    {
+        if (index >= rows.size())
+            rows.resize(index + 1);
+        return rows[index];
+    }
+
+    /// Index of a node, given one if it has none
+    unsigned indexNode(unsigned node);
+
+    std::vector<unsigned> indexOf;      ///< node -> index, NO_INDEX if none
+    std::vector<unsigned> nodeOf;       ///< index -> node
+    Rows succ[NUM_EDGE_LABELS];         ///< label -> index -> successors
+    Rows pred[NUM_EDGE_LABELS];         ///< label -> index -> predecessors
+};
+
+
+/**
+ * FIFO queue in one contiguous array, used circularly; the array doubles when it is full
+ */
+template<class T>
+class RingBuffer
+{
+public:
+    inline bool empty() const
+    { return count == 0; }
+
+    inline size_t size() const
+    { return count; }
+
+    inline void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    inline void push_back(const T &data)
+    {
+        if (count == slots.size())
+            grow();
+        slots[(head + count) & (slots.size() - 1)] = data;
+        count++;
+    }
+
+    inline T pop_front()
+    {
+        T data = slots[head];
+        head = (head + 1) & (slots.size() - 1);
+        count--;
+        return data;
+    }
+
+    /// Bytes of the array, i.e. of the most elements held at once, rounded up to a power of two
+    inline size_t memoryBytes() const
+    { return slots.capacity() * sizeof(T); }
+
+private:
+    void grow()
+    {
+        std::vector<T> bigger(slots.empty() ? 64 : slots.size() * 2);
+        for (size_t i = 0; i < count; ++i)
+            bigger[i] = slots[(head + i) & (slots.size() - 1)];
+        slots.swap(bigger);
+        head = 0;
+    }
+
+    std::vector<T> slots;   ///< capacity is a power of two
+    size_t head = 0;
+    size_t count = 0;
 };
 
 
@@ -139,15 +320,59 @@ public:
     inline T pop()
     {
         assert(!this->empty() && "work list is empty");
-        T data = this->data_list.front();
-        this->data_list.pop_front();
+        T data = this->data_list.pop_front();
         this->data_set.erase(data);
         return data;
     }
 
 protected:
     std::unordered_set<T> data_set;       ///< to avoid duplicate elements
-    std::deque<T> data_list;     ///< to access the elements at both the beginning and the end
+    RingBuffer<T> data_list;     ///< to access the elements at both the beginning and the end
+};
+
+
+/**
+ * FIFO worklist of edges, queued as packed keys.
+ *
+ * There is no set of the queued edges: the solver pushes an edge only when inserting it into the rows of the
+ * graph added it, so the rows dedup the worklist and an edge is queued at most once.
+ */
+template<>
+class WorkList<CFLREdge>
+{
+public:
+    inline bool empty() const
+    { return data_list.empty(); }
+
+    inline void clear()
+    {
+        data_list.clear();
+        pushed = 0;
+    }
+
+    /// Push an edge that was just added to the graph
+    inline void push(const CFLREdge &edge)
+    {
+        data_list.push_back(edge.pack());
+        pushed++;
+    }
+
+    inline CFLREdge pop()
+    {
+        assert(!this->empty() && "work list is empty");
+        return CFLREdge::unpack(data_list.pop_front());
+    }
+
+    /// Number of edges pushed since the last clear
+    inline size_t numPushed() const
+    { return pushed; }
+
+    inline size_t memoryBytes() const
+    { return data_list.memoryBytes(); }
+
+protected:
+    RingBuffer<uint64_t> data_list; ///< packed keys of the edges to pop
+    size_t pushed = 0;
 };
 
 
@@ -160,18 +385,85 @@ class CFLR
     CFLRGraph *graph;
 
 public:
+    /**
+     * How solve() computes the closure: edge at a time from a worklist, or as rounds of boolean products of
+     * one bit matrix per label, which pays off on small graphs that end up dense
+     */
+    enum Engine
+    {
+        WorkListEngine,
+        MatrixEngine,
+        AutoEngine,     ///< the matrix engine if the graph is small and dense enough, the worklist otherwise
+    };
+
     CFLR() : graph(nullptr)
     {}
 
     ~CFLR()
     { delete graph; }
 
+    /// Select the engine by name: worklist, matrix or auto; false if the name is unknown
+    bool setEngine(const std::string &name);
+
+    /// Number of threads of the worklist engine; more than one partitions the edges by source node
+    inline void setThreads(unsigned threads)
+    { numThreads = threads ? threads : 1; }
+
     /// Build a graph from PAG
     void buildGraph(SVF::PAG *pag);
+
+    /// Solve graph instead of one built from a PAG; the solver takes ownership of it
+    inline void setGraph(CFLRGraph *newGraph)
+    {
+        delete graph;
+        graph = newGraph;
+    }
+
+    inline const CFLRGraph *getGraph() const
+    { return graph; }
+
     /// The dynamic-programming CFL-reachability algorithm.
     void solve();
     /// Dump results into a file
     void dumpResult();
+    /// Print the edges and memory of each label
+    void printStats();
+
+private:
+    /// The worklist algorithm, specialized for the lookup tables of a grammar
+    template<const Grammar &grammar>
+    void solveWith();
+
+    /**
+     * Semi-naive fixpoint over bit matrices: each round ORs into every head the products in which one operand
+     * is what the last round derived, until a round derives nothing. The result is written back to the graph.
+     */
+    template<const Grammar &grammar>
+    void solveMatrixWith();
+
+    /**
+     * The worklist algorithm on numThreads threads. Each thread owns the nodes of one partition: the
+     * successors and predecessors of its nodes, and a worklist of its new edges. Edges derived for a node of
+     * another partition are sent to its owner in batches, through a lock-free queue.
+     */
+    template<const Grammar &grammar>
+    void solveParallelWith();
+
+    /// The labels the matrix engine keeps a matrix of, and among them the heads, which get new edges
+    template<const Grammar &grammar>
+    void matrixLabels(LabelMask &heads, LabelMask &labels) const;
+
+    /// Whether the auto engine picks the matrices for the graph
+    template<const Grammar &grammar>
+    bool preferMatrix() const;
+
+    Engine engine = AutoEngine;
+    Engine solvedWith = WorkListEngine;
+    unsigned numThreads = 1;
+    unsigned matrixRounds = 0;
+    size_t matrixBytes = 0;
+    size_t crossPartitionEdges = 0; ///< edges sent to another thread
+    size_t crossPartitionBatches = 0;
 };
 
 #endif //ANSWERS_A4HEADER_H
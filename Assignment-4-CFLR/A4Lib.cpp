@@ -77,16 +77,118 @@ CFLRGraph::CFLRGraph(SVF::SVFIR *pag)
 }
 
 
-bool CFLRGraph::hasEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
+bool CFLRGraph::hasEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel) const
 {
-    return succMap[src][EdgeLabel].count(dst);
+    unsigned srcIndex = getIndex(src);
+    unsigned dstIndex = getIndex(dst);
+    if (srcIndex == NO_INDEX || dstIndex == NO_INDEX)
+        return false;
+    return getSuccessors(srcIndex, EdgeLabel).test(dstIndex);
 }
 
 
 void CFLRGraph::addEdge(unsigned int src, unsigned int dst, EdgeLabel EdgeLabel)
 {
-    succMap[src][EdgeLabel].insert(dst);
-    predMap[dst][EdgeLabel].insert(src);
+    unsigned srcIndex = indexNode(src);
+    addIndexEdge(srcIndex, indexNode(dst), EdgeLabel);
+}
+
+
+unsigned CFLRGraph::indexNode(unsigned node)
+{
+    if (node >= indexOf.size())
+        indexOf.resize(node + 1, NO_INDEX);
+    if (indexOf[node] == NO_INDEX)
+    {
+        indexOf[node] = nodeOf.size();
+        nodeOf.push_back(node);
+    }
+    return indexOf[node];
+}
+
+
+bool CFLRGraph::addIndexEdge(unsigned src, unsigned dst, EdgeLabel label)
+{
+    if (!rowAt(succ[label], src).insert(dst, getNumIndices()))
+        return false;
+    rowAt(pred[label], dst).insert(src, getNumIndices());
+    return true;
+}
+
+
+void CFLRGraph::joinSuccessors(unsigned src, EdgeLabel head, unsigned mid, EdgeLabel right,
+                               std::vector<unsigned> &added)
+{
+    // take the target row first: growing succ[head] may move the rows of succ[right]
+    AdjacencyRow &target = rowAt(succ[head], src);
+    size_t oldSize = added.size();
+    target.unionWith(getSuccessors(mid, right), getNumIndices(), added);
+    for (size_t i = oldSize; i < added.size(); ++i)
+        rowAt(pred[head], added[i]).insert(src, getNumIndices());
+}
+
+
+void CFLRGraph::joinPredecessors(unsigned dst, EdgeLabel head, unsigned mid, EdgeLabel left,
+                                 std::vector<unsigned> &added)
+{
+    AdjacencyRow &target = rowAt(pred[head], dst);
+    size_t oldSize = added.size();
+    target.unionWith(getPredecessors(mid, left), getNumIndices(), added);
+    for (size_t i = oldSize; i < added.size(); ++i)
+        rowAt(succ[head], added[i]).insert(dst, getNumIndices());
+}
+
+
+size_t CFLRGraph::getNumEdges(EdgeLabel label) const
+{
+    size_t edges = 0;
+    for (auto &row : succ[label])
+        edges += row.size();
+    return edges;
+}
+
+
+size_t CFLRGraph::getMemoryBytes(EdgeLabel label) const
+{
+    size_t bytes = (succ[label].capacity() + pred[label].capacity()) * sizeof(AdjacencyRow);
+    for (auto &row : succ[label])
+        bytes += row.memoryBytes();
+    for (auto &row : pred[label])
+        bytes += row.memoryBytes();
+    return bytes;
+}
+
+
+const char *CFLRGraph::getLabelName(EdgeLabel label)
+{
+    static const char *names[NUM_EDGE_LABELS] = {
+            "Addr", "AddrBar",
+            "Copy", "CopyBar",
+            "Store", "StoreBar",
+            "Load", "LoadBar",
+            "PT", "PTBar",
+            "SV", "SVBar",
+            "PV", "PVBar",
+            "VP", "VPBar",
+            "VF", "VFBar",
+            "VA", "VABar",
+            "LV", "LVBar",
+    };
+    return label < NUM_EDGE_LABELS ? names[label] : "?";
+}
+
+
+bool CFLR::setEngine(const std::string &name)
+{
+    if (name == "worklist")
+        engine = WorkListEngine;
+    else if (name == "matrix")
+        engine = MatrixEngine;
+    else if (name == "auto")
+        engine = AutoEngine;
+    else
+        return false;
+    return true;
 }
 
 
@@ -109,15 +211,11 @@ void CFLR::dumpResult()
 
     // Collect S-edges
     std::map<unsigned, std::set<unsigned >> edgeSet;  // ordered edge set
-    for (auto &nodeItr : graph->getSuccessorMap())
+    for (unsigned src = 0; src < graph->getNumIndices(); ++src)
     {
-        unsigned src = nodeItr.first;
-        for (auto &lblItr : nodeItr.second)
-        {
-            if (lblItr.first == PT)
-                for (auto dst : lblItr.second)
-                    edgeSet[src].insert(dst);
-        }
+        graph->getSuccessors(src, PT).forEach([&](unsigned dst) {
+            edgeSet[graph->getNode(src)].insert(graph->getNode(dst));
+        });
     }
 
     // Write S-edges
@@ -128,4 +226,32 @@ void CFLR::dumpResult()
             outFile << srcItr.first << '\t' << "points to" << '\t' << dst << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+void CFLR::printStats()
+{
+    size_t edges = 0;
+    size_t bytes = 0;
+    SVF::SVFUtil::outs() << "################ (CFLR statistics) ################\n";
+    SVF::SVFUtil::outs() << "Engine\t" << (solvedWith == MatrixEngine ? "matrix" : "worklist") << "\n";
+    SVF::SVFUtil::outs() << "Nodes\t" << graph->getNumIndices() << "\n";
+    SVF::SVFUtil::outs() << "Threads\t" << (solvedWith == MatrixEngine ? 1 : numThreads) << "\n";
+    SVF::SVFUtil::outs() << "Label\tEdges\tBytes\n";
+    for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+    {
+        size_t labelEdges = graph->getNumEdges(label);
+        size_t labelBytes = graph->getMemoryBytes(label);
+        edges += labelEdges;
+        bytes += labelBytes;
+        if (labelEdges)
+            SVF::SVFUtil::outs() << CFLRGraph::getLabelName(label) << "\t" << labelEdges << "\t" << labelBytes << "\n";
+    }
+    SVF::SVFUtil::outs() << "Total\t" << edges << "\t" << bytes << "\n";
+    SVF::SVFUtil::outs() << "MatrixRounds\t" << matrixRounds << "\n";
+    SVF::SVFUtil::outs() << "MatrixBytes\t" << matrixBytes << "\n";
+    SVF::SVFUtil::outs() << "CrossPartitionEdges\t" << crossPartitionEdges << "\n";
+    SVF::SVFUtil::outs() << "CrossPartitionBatches\t" << crossPartitionBatches << "\n";
+    SVF::SVFUtil::outs() << "QueuedEdges\t" << workList.numPushed() << "\n";
+    SVF::SVFUtil::outs() << "WorkListBytes\t" << workList.memoryBytes() << "\n";
+    SVF::SVFUtil::outs() << "###################################################\n";
+}
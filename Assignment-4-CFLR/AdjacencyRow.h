@@ -0,0 +1,161 @@
+/**
+ * AdjacencyRow.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_ADJACENCYROW_H
+#define ANSWERS_ADJACENCYROW_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/**
+ * The successors (or predecessors) of one node through one label, as a set of dense node indices.
+ *
+ * A row starts as a sorted vector and turns into a bitmap over all indices once the bitmap is smaller,
+ * i.e. once it holds more than 1/32 of the indices. Joining two bitmap rows is a word-level OR that also
+ * yields the new members.
+ */
+class AdjacencyRow
+{
+public:
+    using Word = uint64_t;
+    static constexpr unsigned WORD_BITS = 64;
+
+    inline bool empty() const
+    { return count == 0; }
+
+    inline unsigned size() const
+    { return count; }
+
+    /// Check whether k is a member; never allocates
+    inline bool test(unsigned k) const
+    {
+        if (dense)
+            return k / WORD_BITS < bits.size() && ((bits[k / WORD_BITS] >> (k % WORD_BITS)) & 1);
+        return std::binary_search(sparse.begin(), sparse.end(), k);
+    }
+
+    /**
+     * Add k to the row; universe is the number of node indices
+     * @return true if k was not a member
+     */
+    bool insert(unsigned k, unsigned universe)
+    {
+        if (dense)
+        {
+            if (k / WORD_BITS >= bits.size())
+                bits.resize(k / WORD_BITS + 1, 0);
+            Word mask = Word(1) << (k % WORD_BITS);
+            if (bits[k / WORD_BITS] & mask)
+                return false;
+            bits[k / WORD_BITS] |= mask;
+            ++count;
+            return true;
+        }
+
+        auto it = std::lower_bound(sparse.begin(), sparse.end(), k);
+        if (it != sparse.end() && *it == k)
+            return false;
+        sparse.insert(it, k);
+        ++count;
+        if (shouldBeDense(universe))
+            makeDense(universe);
+        return true;
+    }
+
+    /// Add the members of rhs, appending the ones that were not members to added
+    void unionWith(const AdjacencyRow &rhs, unsigned universe, std::vector<unsigned> &added)
+    {
+        if (this == &rhs || rhs.empty())
+            return;
+        if (!dense && (rhs.dense || (count + rhs.count) * 32 > universe))
+            makeDense(universe);
+
+        if (dense && rhs.dense)
+        {
+            if (bits.size() < rhs.bits.size())
+                bits.resize(rhs.bits.size(), 0);
+            for (size_t w = 0; w < rhs.bits.size(); ++w)
+            {
+                Word fresh = rhs.bits[w] & ~bits[w];
+                if (!fresh)
+                    continue;
+                bits[w] |= fresh;
+                count += __builtin_popcountll(fresh);
+                for (; fresh; fresh &= fresh - 1)
+                    added.push_back(w * WORD_BITS + __builtin_ctzll(fresh));
+            }
+        }
+        else if (dense)
+        {
+            for (auto k : rhs.sparse)
+                if (insert(k, universe))
+                    added.push_back(k);
+        }
+        else
+        {
+            // both sorted: the new members are rhs - this
+            size_t oldSize = added.size();
+            std::set_difference(rhs.sparse.begin(), rhs.sparse.end(), sparse.begin(), sparse.end(),
+                                std::back_inserter(added));
+            if (added.size() == oldSize)
+                return;
+            std::vector<unsigned> merged;
+            merged.reserve(sparse.size() + added.size() - oldSize);
+            std::merge(sparse.begin(), sparse.end(), added.begin() + oldSize, added.end(),
+                       std::back_inserter(merged));
+            sparse.swap(merged);
+            count = sparse.size();
+            if (shouldBeDense(universe))
+                makeDense(universe);
+        }
+    }
+
+    /// Apply f to each member, in ascending order
+    template<class F>
+    void forEach(F f) const
+    {
+        if (!dense)
+        {
+            for (auto k : sparse)
+                f(k);
+            return;
+        }
+        for (size_t w = 0; w < bits.size(); ++w)
+        {
+            for (Word word = bits[w]; word; word &= word - 1)
+                f((unsigned) (w * WORD_BITS + __builtin_ctzll(word)));
+        }
+    }
+
+    /// Heap bytes held by the row
+    inline size_t memoryBytes() const
+    { return sparse.capacity() * sizeof(unsigned) + bits.capacity() * sizeof(Word); }
+
+private:
+    inline bool shouldBeDense(unsigned universe) const
+    { return (size_t) count * 32 > universe; }
+
+    void makeDense(unsigned universe)
+    {
+        bits.assign((universe + WORD_BITS - 1) / WORD_BITS, 0);
+        for (auto k : sparse)
+        {
+            if (k / WORD_BITS >= bits.size())
+                bits.resize(k / WORD_BITS + 1, 0);
+            bits[k / WORD_BITS] |= Word(1) << (k % WORD_BITS);
+        }
+        std::vector<unsigned>().swap(sparse);
+        dense = true;
+    }
+
+    std::vector<unsigned> sparse;   ///< sorted members, while the row is sparse
+    std::vector<Word> bits;         ///< bitmap over the node indices, once the row is dense
+    unsigned count = 0;
+    bool dense = false;
+};
+
+#endif //ANSWERS_ADJACENCYROW_H
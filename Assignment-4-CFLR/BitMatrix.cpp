@@ -0,0 +1,114 @@
+/**
+ * BitMatrix.cpp
+ * @author kisslune
+ */
+
+#include "BitMatrix.h"
+
+#include <algorithm>
+#include <cassert>
+
+/// Words of a row slice ORed at a time: the slices of all rows of y stay in cache across the rows of x
+static constexpr size_t TILE_WORDS = 16;
+
+bool BitMatrix::empty() const
+{
+    return std::all_of(usedRows.begin(), usedRows.end(), [](Word w) { return w == 0; });
+}
+
+
+void BitMatrix::clear()
+{
+    forEachUsedRow([&](unsigned i) { std::fill(row(i), row(i) + wordsPerRow, 0); });
+    std::fill(usedRows.begin(), usedRows.end(), 0);
+}
+
+
+void BitMatrix::orProduct(const BitMatrix &x, const BitMatrix &y)
+{
+    assert(x.n == n && y.n == n && this != &x && this != &y && "bad operands of a matrix product");
+
+    // only the rows of x that reach a used row of y contribute
+    std::vector<unsigned> rows;
+    x.forEachUsedRow([&](unsigned i) {
+        const Word *xi = x.row(i);
+        for (size_t w = 0; w < wordsPerRow; ++w)
+        {
+            if (xi[w] & y.usedRows[w])
+            {
+                rows.push_back(i);
+                usedRows[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+                return;
+            }
+        }
+    });
+    if (rows.empty())
+        return;
+
+    for (size_t col = 0; col < wordsPerRow; col += TILE_WORDS)
+    {
+        size_t end = std::min(wordsPerRow, col + TILE_WORDS);
+        for (auto i : rows)
+        {
+            const Word *xi = x.row(i);
+            Word *__restrict ri = row(i);
+            for (size_t w = 0; w < wordsPerRow; ++w)
+            {
+                for (Word word = xi[w] & y.usedRows[w]; word; word &= word - 1)
+                {
+                    const Word *__restrict yk = y.row(w * WORD_BITS + __builtin_ctzll(word));
+                    for (size_t c = col; c < end; ++c)
+                        ri[c] |= yk[c];
+                }
+            }
+        }
+    }
+}
+
+
+void BitMatrix::orWith(const BitMatrix &x)
+{
+    assert(x.n == n && "bad operand of a matrix union");
+    x.forEachUsedRow([&](unsigned i) {
+        const Word *xi = x.row(i);
+        Word *ri = row(i);
+        for (size_t w = 0; w < wordsPerRow; ++w)
+            ri[w] |= xi[w];
+        usedRows[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+    });
+}
+
+
+bool BitMatrix::keepNewAndMerge(BitMatrix &total)
+{
+    assert(total.n == n && "bad operand of a matrix merge");
+    // the rows left empty are dropped from usedRows
+    std::vector<Word> stillUsed(usedRows.size(), 0);
+    forEachUsedRow([&](unsigned i) {
+        Word *ri = row(i);
+        Word *ti = total.row(i);
+        Word any = 0;
+        for (size_t w = 0; w < wordsPerRow; ++w)
+        {
+            ri[w] &= ~ti[w];
+            ti[w] |= ri[w];
+            any |= ri[w];
+        }
+        if (any)
+        {
+            stillUsed[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+            total.usedRows[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+        }
+    });
+    usedRows.swap(stillUsed);
+    return !empty();
+}
+
+
+size_t BitMatrix::count() const
+{
+    size_t set = 0;
+    for (auto w : bits)
+        set += __builtin_popcountll(w);
+    return set;
+}
@@ -0,0 +1,99 @@
+/**
+ * BitMatrix.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_BITMATRIX_H
+#define ANSWERS_BITMATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Square boolean matrix over node indices, one bit per entry, rows padded to whole words.
+ * Row i holds the successors of index i through one label.
+ *
+ * A second bitmap marks the rows that may hold something, so that the operations on a sparse matrix only
+ * touch its non-empty rows.
+ */
+class BitMatrix
+{
+public:
+    using Word = uint64_t;
+    static constexpr unsigned WORD_BITS = 64;
+
+    BitMatrix() = default;
+
+    explicit BitMatrix(unsigned n) :
+            n(n), wordsPerRow((n + WORD_BITS - 1) / WORD_BITS), bits((size_t) n * wordsPerRow, 0),
+            usedRows(wordsPerRow, 0)
+    {}
+
+    inline unsigned size() const
+    { return n; }
+
+    inline size_t getWordsPerRow() const
+    { return wordsPerRow; }
+
+    inline const Word *row(unsigned i) const
+    { return bits.data() + (size_t) i * wordsPerRow; }
+
+    inline Word *row(unsigned i)
+    { return bits.data() + (size_t) i * wordsPerRow; }
+
+    inline bool test(unsigned i, unsigned j) const
+    { return (row(i)[j / WORD_BITS] >> (j % WORD_BITS)) & 1; }
+
+    inline void set(unsigned i, unsigned j)
+    {
+        row(i)[j / WORD_BITS] |= Word(1) << (j % WORD_BITS);
+        usedRows[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+    }
+
+    /// Check whether no entry is set
+    bool empty() const;
+
+    void clear();
+
+    /// this |= x * y, the boolean product: (i, j) is set if (i, k) is set in x and (k, j) in y for some k
+    void orProduct(const BitMatrix &x, const BitMatrix &y);
+
+    /// this |= x
+    void orWith(const BitMatrix &x);
+
+    /**
+     * Keep only the entries that are not in total, and add them to total
+     * @return true if an entry is left
+     */
+    bool keepNewAndMerge(BitMatrix &total);
+
+    /// Number of set entries
+    size_t count() const;
+
+    inline size_t memoryBytes() const
+    { return (bits.capacity() + usedRows.capacity()) * sizeof(Word); }
+
+    /// Bytes of a matrix over n indices
+    static inline size_t memoryBytes(unsigned n)
+    { return ((size_t) n + 1) * ((n + WORD_BITS - 1) / WORD_BITS) * sizeof(Word); }
+
+private:
+    /// Apply f to each row that may hold something
+    template<class F>
+    void forEachUsedRow(F f) const
+    {
+        for (size_t w = 0; w < usedRows.size(); ++w)
+        {
+            for (Word word = usedRows[w]; word; word &= word - 1)
+                f((unsigned) (w * WORD_BITS + __builtin_ctzll(word)));
+        }
+    }
+
+    unsigned n = 0;
+    size_t wordsPerRow = 0;
+    std::vector<Word> bits;
+    std::vector<Word> usedRows;     ///< one bit per row, set if the row may hold something
+};
+
+#endif //ANSWERS_BITMATRIX_H
@@ -0,0 +1,79 @@
+/**
+ * CFLGrammar.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_CFLGRAMMAR_H
+#define ANSWERS_CFLGRAMMAR_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Set of edge labels, one bit per label
+using LabelMask = uint64_t;
+
+/**
+ * A production of a normalized grammar: head ::= left right, or head ::= left if right is NO_LABEL.
+ * Longer right-hand sides are split with intermediate labels before they get here.
+ */
+struct Production
+{
+    static constexpr unsigned NO_LABEL = ~0u;
+
+    unsigned head;
+    unsigned left;
+    unsigned right;
+};
+
+
+/**
+ * Lookup tables of a normalized grammar over numLabels edge labels, built at compile time.
+ *
+ * The solver joins an edge labelled B with an adjacent edge labelled C by one lookup of binary[B][C], the set
+ * of heads A of the productions A ::= B C. rightPartners[B] (leftPartners[C]) lists the labels C (B) for
+ * which that set is not empty, so the solver only walks adjacent edges that can match. A new grammar is a
+ * new list of productions; the solver does not change.
+ */
+template<unsigned numLabels>
+struct CFLGrammar
+{
+    static_assert(numLabels <= 64, "a LabelMask holds at most 64 labels");
+    static constexpr unsigned NUM_LABELS = numLabels;
+
+    LabelMask unary[numLabels];                 ///< B -> heads A of A ::= B
+    LabelMask binary[numLabels][numLabels];     ///< (B, C) -> heads A of A ::= B C
+    LabelMask rightPartners[numLabels];         ///< B -> labels C of the productions A ::= B C
+    LabelMask leftPartners[numLabels];          ///< C -> labels B of the productions A ::= B C
+
+    template<size_t numProductions>
+    static constexpr CFLGrammar build(const Production (&productions)[numProductions])
+    {
+        CFLGrammar grammar{};
+        for (size_t i = 0; i < numProductions; ++i)
+        {
+            const Production &p = productions[i];
+            if (p.right == Production::NO_LABEL)
+            {
+                grammar.unary[p.left] |= LabelMask(1) << p.head;
+            }
+            else
+            {
+                grammar.binary[p.left][p.right] |= LabelMask(1) << p.head;
+                grammar.rightPartners[p.left] |= LabelMask(1) << p.right;
+                grammar.leftPartners[p.right] |= LabelMask(1) << p.left;
+            }
+        }
+        return grammar;
+    }
+};
+
+
+/// Apply f to each label in mask, in ascending order
+template<class F>
+inline void forEachLabel(LabelMask mask, F f)
+{
+    for (; mask; mask &= mask - 1)
+        f((unsigned) __builtin_ctzll(mask));
+}
+
+#endif //ANSWERS_CFLGRAMMAR_H
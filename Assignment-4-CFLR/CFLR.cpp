@@ -9,6 +9,13 @@ using namespace SVF;
 using namespace llvm;
 using namespace std;
 
+static Option<bool> PrintStats("cflr-stat", "Print the edges and memory of each label after solving", false);
+static Option<std::string> Engine("cflr-engine", "Solver of CFL-reachability: worklist, matrix (boolean products of "
+                                                 "per-label bit matrices) or auto (matrix on small dense graphs)",
+                                  "auto");
+static Option<unsigned> Threads("cflr-threads", "Number of threads of the worklist engine (the edges are "
+                                                "partitioned by source node)", 1);
+
 int main(int argc, char **argv)
 {
     auto moduleNameVec =
@@ -22,21 +29,19 @@ int main(int argc, char **argv)
     pag->dump();
 
     CFLR solver;
+    if (!solver.setEngine(Engine()))
+    {
+        SVF::SVFUtil::errs() << "unknown engine '" << Engine() << "', expected worklist, matrix or auto\n";
+        return 1;
+    }
+    solver.setThreads(Threads());
     solver.buildGraph(pag);
     // TODO: complete this method
     solver.solve();
     solver.dumpResult();
+    if (PrintStats())
+        solver.printStats();
 
     LLVMModuleSet::releaseLLVMModuleSet();
     return 0;
 }
-
-
-void CFLR::solve()
-{
-    // TODO: complete this function. The implementations of graph and worklist are provided.
-    //  You need to:
-    //  1. implement the grammar production rules into code;
-    //  2. implement the dynamic-programming CFL-reachability algorithm.
-    //  You may need to add your new methods to 'CFLRGraph' and 'CFLR'.
-}
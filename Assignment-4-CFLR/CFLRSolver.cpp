@@ -0,0 +1,192 @@
+/**
+ * CFLRSolver.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+void CFLR::solve()
+{
+    solvedWith = engine == AutoEngine ? (preferMatrix<pointerGrammar>() ? MatrixEngine : WorkListEngine) : engine;
+    if (solvedWith == MatrixEngine)
+        solveMatrixWith<pointerGrammar>();
+    else if (numThreads > 1)
+        solveParallelWith<pointerGrammar>();
+    else
+        solveWith<pointerGrammar>();
+}
+
+
+template<const Grammar &grammar>
+void CFLR::solveWith()
+{
+    // the worklist holds node indices, not nodes
+    for (unsigned src = 0; src < graph->getNumIndices(); ++src)
+    {
+        for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+            graph->getSuccessors(src, label).forEach([&](unsigned dst) { workList.push(CFLREdge(src, dst, label)); });
+    }
+
+    std::vector<unsigned> added;
+    while (!workList.empty())
+    {
+        CFLREdge edge = workList.pop();
+
+        // head ::= edge
+        forEachLabel(grammar.unary[edge.label], [&](unsigned head) {
+            if (graph->addIndexEdge(edge.src, edge.dst, head))
+                workList.push(CFLREdge(edge.src, edge.dst, head));
+        });
+
+        // head ::= edge right, with right leaving edge.dst: OR the row of edge.dst into the one of edge.src
+        forEachLabel(grammar.rightPartners[edge.label], [&](unsigned right) {
+            if (graph->getSuccessors(edge.dst, right).empty())
+                return;
+            forEachLabel(grammar.binary[edge.label][right], [&](unsigned head) {
+                added.clear();
+                graph->joinSuccessors(edge.src, head, edge.dst, right, added);
+                for (auto dst : added)
+                    workList.push(CFLREdge(edge.src, dst, head));
+            });
+        });
+
+        // head ::= left edge, with left entering edge.src
+        forEachLabel(grammar.leftPartners[edge.label], [&](unsigned left) {
+            if (graph->getPredecessors(edge.src, left).empty())
+                return;
+            forEachLabel(grammar.binary[left][edge.label], [&](unsigned head) {
+                added.clear();
+                graph->joinPredecessors(edge.dst, head, edge.src, left, added);
+                for (auto src : added)
+                    workList.push(CFLREdge(src, edge.dst, head));
+            });
+        });
+    }
+}
+
+
+/**
+ * The auto engine takes the matrices for graphs with at least this share of the n^2 possible edges, as long as
+ * all matrices of the solve take at most this many bytes
+ */
+static constexpr double MATRIX_MIN_DENSITY = 1.0 / 1024;
+static constexpr size_t MATRIX_MAX_BYTES = (size_t) 64 << 20;
+
+template<const Grammar &grammar>
+void CFLR::matrixLabels(LabelMask &heads, LabelMask &labels) const
+{
+    // heads get new edges; the other labels only hold the edges of the graph
+    heads = 0;
+    labels = 0;
+    for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+    {
+        heads |= grammar.unary[label];
+        for (EdgeLabel right = 0; right < NUM_EDGE_LABELS; ++right)
+            heads |= grammar.binary[label][right];
+        if (graph->getNumEdges(label))
+            labels |= LabelMask(1) << label;
+    }
+    labels |= heads;
+}
+
+
+template<const Grammar &grammar>
+bool CFLR::preferMatrix() const
+{
+    // a matrix takes n^2 bits whatever the edges, and a product n^3 / 64 word operations; the worklist pays per
+    // edge, so the matrices only pay off on graphs that are small and dense
+    unsigned n = graph->getNumIndices();
+    if (n == 0)
+        return false;
+
+    // every label has a matrix of all its edges, and every head two more: the edges of the last round and of
+    // this one
+    LabelMask heads, labels;
+    matrixLabels<grammar>(heads, labels);
+    size_t matrices = __builtin_popcountll(labels) + 2 * __builtin_popcountll(heads);
+    if (matrices * BitMatrix::memoryBytes(n) > MATRIX_MAX_BYTES)
+        return false;
+
+    size_t edges = 0;
+    for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+        edges += graph->getNumEdges(label);
+    return (double) edges / ((double) n * n) >= MATRIX_MIN_DENSITY;
+}
+
+
+template<const Grammar &grammar>
+void CFLR::solveMatrixWith()
+{
+    unsigned n = graph->getNumIndices();
+
+    LabelMask heads, labels;
+    matrixLabels<grammar>(heads, labels);
+
+    std::vector<BitMatrix> total(NUM_EDGE_LABELS);  // every edge so far
+    std::vector<BitMatrix> delta(NUM_EDGE_LABELS);  // edges derived by the last round
+    std::vector<BitMatrix> next(NUM_EDGE_LABELS);   // edges derived by this round
+    forEachLabel(labels, [&](unsigned label) {
+        total[label] = BitMatrix(n);
+        for (unsigned src = 0; src < n; ++src)
+            graph->getSuccessors(src, label).forEach([&](unsigned dst) { total[label].set(src, dst); });
+    });
+    forEachLabel(heads, [&](unsigned label) {
+        delta[label] = BitMatrix(n);
+        next[label] = BitMatrix(n);
+    });
+
+    // in the first round, every edge is new
+    matrixRounds = 0;
+    auto deltaOf = [&](unsigned label) -> const BitMatrix & {
+        return matrixRounds == 0 ? total[label] : delta[label];
+    };
+    LabelMask changed = labels;
+    while (changed)
+    {
+        for (EdgeLabel left = 0; left < NUM_EDGE_LABELS; ++left)
+        {
+            if (!((labels >> left) & 1))
+                continue;
+            bool leftChanged = (changed >> left) & 1;
+            if (leftChanged)
+                forEachLabel(grammar.unary[left], [&](unsigned head) { next[head].orWith(deltaOf(left)); });
+
+            // labels without a matrix have no edge
+            forEachLabel(grammar.rightPartners[left] & labels, [&](unsigned right) {
+                bool rightChanged = (changed >> right) & 1;
+                forEachLabel(grammar.binary[left][right], [&](unsigned head) {
+                    if (leftChanged)
+                        next[head].orProduct(deltaOf(left), total[right]);
+                    if (rightChanged)
+                        next[head].orProduct(total[left], deltaOf(right));
+                });
+            });
+        }
+
+        changed = 0;
+        forEachLabel(heads, [&](unsigned head) {
+            if (next[head].keepNewAndMerge(total[head]))
+                changed |= LabelMask(1) << head;
+            std::swap(delta[head], next[head]);
+            next[head].clear();
+        });
+        matrixRounds++;
+    }
+
+    matrixBytes = 0;
+    for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+        matrixBytes += total[label].memoryBytes() + delta[label].memoryBytes() + next[label].memoryBytes();
+
+    // write the derived edges back, so that the graph holds what the worklist engine would have left
+    forEachLabel(heads, [&](unsigned label) {
+        for (unsigned src = 0; src < n; ++src)
+        {
+            const BitMatrix::Word *row = total[label].row(src);
+            for (size_t w = 0; w < total[label].getWordsPerRow(); ++w)
+            {
+                for (BitMatrix::Word word = row[w]; word; word &= word - 1)
+                    graph->addIndexEdge(src, w * BitMatrix::WORD_BITS + __builtin_ctzll(word), label);
+            }
+        }
+    });
+}
@@ -0,0 +1,409 @@
+/**
+ * ParallelCFLR.cpp
+ * @author kisslune
+ */
+
+#include "A4Header.h"
+
+#include <atomic>
+#include <thread>
+
+/*
+ * Parallel worklist mode.
+ *
+ * Node index i belongs to thread i % T. A thread keeps the successor rows and the predecessor rows of its
+ * nodes, so an edge (a, b) is stored twice: as a successor of a by the owner of a, and as a predecessor of b
+ * by the owner of b (only for the labels that are the left operand of a production). Each production
+ * head ::= left right is applied at the node in the middle, whose owner holds both the left edges that enter
+ * it and the right edges that leave it. As in the serial engine, a join is the union of a whole row: a new
+ * predecessor (a, m) adds the successors of m to the ones of a, and a new successor (m, b) adds the
+ * predecessors of m to the ones of b. The owner of a (b) takes the union, on a copy of the row if it is
+ * another thread, and sends each edge that is new to the owner of the other end.
+ *
+ * No row is shared, so the threads take no lock. Edges for another thread are buffered per target and sent
+ * as a batch through that thread's multi-producer queue. pending counts the batches that are sent and not
+ * yet fully processed, plus one for the seeds of each thread; it is decremented only once what a batch
+ * derived has been sent, so the threads stop when it drops to zero. The result is the least fixed point of
+ * the productions, the same as the one of the serial engine.
+ */
+
+namespace
+{
+
+/// Rows to add to the successors (or predecessors) of a node through a label
+struct RowUnion
+{
+    unsigned index;
+    EdgeLabel label;
+    bool successors;
+    AdjacencyRow row;
+};
+
+/// Edges sent to one thread: single edges as packed keys, and rows
+struct EdgeBatch
+{
+    std::vector<uint64_t> outs;     ///< edges to add as successors of their source
+    std::vector<uint64_t> ins;      ///< edges to add as predecessors of their target
+    std::vector<RowUnion> rows;
+    size_t edges = 0;               ///< edges in all of the above
+    std::atomic<EdgeBatch *> next{nullptr};
+};
+
+/**
+ * Multi-producer single-consumer queue of batches, after Vyukov's intrusive queue: a producer links a
+ * batch with one exchange, the consumer pops without any atomic read-modify-write on the common path
+ */
+class BatchQueue
+{
+public:
+    BatchQueue() :
+            head(&stub), tail(&stub)
+    {}
+
+    void push(EdgeBatch *batch)
+    {
+        batch->next.store(nullptr, std::memory_order_relaxed);
+        EdgeBatch *prev = head.exchange(batch, std::memory_order_acq_rel);
+        prev->next.store(batch, std::memory_order_release);
+    }
+
+    /// The oldest batch, or nullptr if there is none or a producer has not finished linking it yet
+    EdgeBatch *pop()
+    {
+        EdgeBatch *first = tail;
+        EdgeBatch *next = first->next.load(std::memory_order_acquire);
+        if (first == &stub)
+        {
+            if (!next)
+                return nullptr;
+            tail = first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            tail = next;
+            return first;
+        }
+        if (first != head.load(std::memory_order_acquire))
+            return nullptr;
+
+        // first is the last batch: put the stub behind it, so that taking it does not empty the list
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (!next)
+            return nullptr;
+        tail = next;
+        return first;
+    }
+
+private:
+    EdgeBatch stub;
+    std::atomic<EdgeBatch *> head;
+    EdgeBatch *tail;
+};
+
+/// Edges per batch before it is sent
+constexpr size_t BATCH_EDGES = 4096;
+
+/// One partition of the graph and the thread that solves it
+class PartitionSolver
+{
+public:
+    PartitionSolver(unsigned id, std::vector<PartitionSolver *> &partitions, const Grammar &grammar,
+                    unsigned universe, std::atomic<size_t> &pending) :
+            id(id), partitions(partitions), grammar(grammar), universe(universe), pending(pending),
+            outgoing(partitions.size(), nullptr)
+    {}
+
+    /// Queue the edges of graph that touch the nodes of this partition
+    void seed(const CFLRGraph &graph)
+    {
+        unsigned numPartitions = partitions.size();
+        for (unsigned index = id; index < universe; index += numPartitions)
+        {
+            for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+            {
+                graph.getSuccessors(index, label).forEach([&](unsigned dst) { addOut(index, label, dst); });
+                if (grammar.rightPartners[label])
+                    graph.getPredecessors(index, label).forEach([&](unsigned src) { addIn(src, label, index); });
+            }
+        }
+    }
+
+    /// Work until no thread has anything left
+    void run()
+    {
+        size_t processed = 1;   // the seeds
+        while (true)
+        {
+            while (!outQueue.empty() || !inQueue.empty())
+            {
+                if (!outQueue.empty())
+                    processOut(CFLREdge::unpack(outQueue.pop_front()));
+                else
+                    processIn(CFLREdge::unpack(inQueue.pop_front()));
+            }
+            for (unsigned to = 0; to < outgoing.size(); ++to)
+                send(to);
+            if (processed)
+            {
+                pending.fetch_sub(processed);
+                processed = 0;
+            }
+
+            if (EdgeBatch *batch = inbox.pop())
+            {
+                for (auto key : batch->outs)
+                {
+                    CFLREdge edge = CFLREdge::unpack(key);
+                    addOut(edge.src, edge.label, edge.dst);
+                }
+                for (auto key : batch->ins)
+                {
+                    CFLREdge edge = CFLREdge::unpack(key);
+                    addIn(edge.src, edge.label, edge.dst);
+                }
+                for (auto &rowUnion : batch->rows)
+                {
+                    if (rowUnion.successors)
+                        unionSuccessors(rowUnion.index, rowUnion.label, rowUnion.row);
+                    else
+                        unionPredecessors(rowUnion.index, rowUnion.label, rowUnion.row);
+                }
+                delete batch;
+                processed++;
+                continue;
+            }
+            if (pending.load() == 0)
+                return;
+            std::this_thread::yield();
+        }
+    }
+
+    /// Apply f(src, dst, label) to each edge whose source is in this partition
+    template<class F>
+    void forEachEdge(F f) const
+    {
+        unsigned numPartitions = partitions.size();
+        for (EdgeLabel label = 0; label < NUM_EDGE_LABELS; ++label)
+        {
+            for (unsigned local = 0; local < succ[label].size(); ++local)
+                succ[label][local].forEach([&](unsigned dst) { f(local * numPartitions + id, dst, label); });
+        }
+    }
+
+    size_t sentEdges = 0;
+    size_t sentBatches = 0;
+
+private:
+    inline unsigned ownerOf(unsigned index) const
+    { return index % partitions.size(); }
+
+    inline AdjacencyRow &rowAt(std::vector<AdjacencyRow> &rows, unsigned index)
+    {
+        unsigned local = index / partitions.size();
+        if (local >= rows.size())
+            rows.resize(local + 1);
+        return rows[local];
+    }
+
+    /// Add an edge whose source is in this partition; queue it if it is new
+    inline void addOut(unsigned src, EdgeLabel label, unsigned dst)
+    {
+        if (rowAt(succ[label], src).insert(dst, universe))
+            outQueue.push_back(CFLREdge(src, dst, label).pack());
+    }
+
+    /// Add an edge whose target is in this partition; queue it if it is new
+    inline void addIn(unsigned src, EdgeLabel label, unsigned dst)
+    {
+        if (rowAt(pred[label], dst).insert(src, universe))
+            inQueue.push_back(CFLREdge(src, dst, label).pack());
+    }
+
+    inline const AdjacencyRow &rowOf(const std::vector<AdjacencyRow> &rows, unsigned index) const
+    {
+        static const AdjacencyRow empty;
+        unsigned local = index / partitions.size();
+        return local < rows.size() ? rows[local] : empty;
+    }
+
+    /// Send a derived edge to the owner of its source
+    inline void sendOut(unsigned src, EdgeLabel label, unsigned dst)
+    {
+        if (ownerOf(src) == id)
+            addOut(src, label, dst);
+        else
+            batchFor(ownerOf(src), 1).outs.push_back(CFLREdge(src, dst, label).pack());
+    }
+
+    /// Send a derived edge to the owner of its target, if it can be a left operand
+    inline void sendIn(unsigned src, EdgeLabel label, unsigned dst)
+    {
+        if (!grammar.rightPartners[label])
+            return;
+        if (ownerOf(dst) == id)
+            addIn(src, label, dst);
+        else
+            batchFor(ownerOf(dst), 1).ins.push_back(CFLREdge(src, dst, label).pack());
+    }
+
+    /// Add row to the successors of index, which is in this partition
+    void unionSuccessors(unsigned index, EdgeLabel label, const AdjacencyRow &row)
+    {
+        added.clear();
+        rowAt(succ[label], index).unionWith(row, universe, added);
+        for (auto dst : added)
+        {
+            outQueue.push_back(CFLREdge(index, dst, label).pack());
+            sendIn(index, label, dst);
+        }
+    }
+
+    /// Add row to the predecessors of index, which is in this partition
+    void unionPredecessors(unsigned index, EdgeLabel label, const AdjacencyRow &row)
+    {
+        added.clear();
+        rowAt(pred[label], index).unionWith(row, universe, added);
+        for (auto src : added)
+        {
+            inQueue.push_back(CFLREdge(src, index, label).pack());
+            sendOut(src, label, index);
+        }
+    }
+
+    /// head(src, x) for each right(mid, x), with mid in this partition
+    void joinSuccessors(unsigned src, EdgeLabel head, unsigned mid, EdgeLabel right)
+    {
+        if (ownerOf(src) != id)
+        {
+            const AdjacencyRow &row = rowOf(succ[right], mid);
+            batchFor(ownerOf(src), row.size()).rows.push_back({src, head, true, row});
+            return;
+        }
+        // grow the target rows first: that may move the row of mid
+        rowAt(succ[head], src);
+        unionSuccessors(src, head, rowOf(succ[right], mid));
+    }
+
+    /// head(x, dst) for each left(x, mid), with mid in this partition
+    void joinPredecessors(unsigned dst, EdgeLabel head, unsigned mid, EdgeLabel left)
+    {
+        const AdjacencyRow &row = rowOf(pred[left], mid);
+        if (!grammar.rightPartners[head])
+        {
+            // no predecessor rows for head: send the edges one by one
+            row.forEach([&](unsigned src) { sendOut(src, head, dst); });
+            return;
+        }
+        if (ownerOf(dst) != id)
+        {
+            batchFor(ownerOf(dst), row.size()).rows.push_back({dst, head, false, row});
+            return;
+        }
+        rowAt(pred[head], dst);
+        unionPredecessors(dst, head, rowOf(pred[left], mid));
+    }
+
+    /// head ::= edge, and head ::= left edge with left entering edge.src
+    void processOut(const CFLREdge &edge)
+    {
+        forEachLabel(grammar.unary[edge.label], [&](unsigned head) {
+            sendOut(edge.src, head, edge.dst);
+            sendIn(edge.src, head, edge.dst);
+        });
+        forEachLabel(grammar.leftPartners[edge.label], [&](unsigned left) {
+            if (rowOf(pred[left], edge.src).empty())
+                return;
+            forEachLabel(grammar.binary[left][edge.label], [&](unsigned head) {
+                joinPredecessors(edge.dst, head, edge.src, left);
+            });
+        });
+    }
+
+    /// head ::= edge right, with right leaving edge.dst
+    void processIn(const CFLREdge &edge)
+    {
+        forEachLabel(grammar.rightPartners[edge.label], [&](unsigned right) {
+            if (rowOf(succ[right], edge.dst).empty())
+                return;
+            forEachLabel(grammar.binary[edge.label][right], [&](unsigned head) {
+                joinSuccessors(edge.src, head, edge.dst, right);
+            });
+        });
+    }
+
+    /// Batch for thread to, with room for edges more edges
+    EdgeBatch &batchFor(unsigned to, size_t edges)
+    {
+        if (outgoing[to] && outgoing[to]->edges >= BATCH_EDGES)
+            send(to);
+        if (!outgoing[to])
+            outgoing[to] = new EdgeBatch;
+        outgoing[to]->edges += edges;
+        return *outgoing[to];
+    }
+
+    void send(unsigned to)
+    {
+        if (!outgoing[to])
+            return;
+        sentEdges += outgoing[to]->edges;
+        sentBatches++;
+        pending.fetch_add(1);
+        partitions[to]->inbox.push(outgoing[to]);
+        outgoing[to] = nullptr;
+    }
+
+    unsigned id;
+    std::vector<PartitionSolver *> &partitions;
+    const Grammar &grammar;
+    unsigned universe;
+    std::atomic<size_t> &pending;
+
+    std::vector<AdjacencyRow> succ[NUM_EDGE_LABELS];    ///< label -> local index -> successors
+    std::vector<AdjacencyRow> pred[NUM_EDGE_LABELS];    ///< label -> local index -> predecessors
+    RingBuffer<uint64_t> outQueue;  ///< new successors to join
+    RingBuffer<uint64_t> inQueue;   ///< new predecessors to join
+    std::vector<EdgeBatch *> outgoing;  ///< target thread -> batch being filled
+    std::vector<unsigned> added;
+    BatchQueue inbox;
+};
+
+}
+
+
+template<const Grammar &grammar>
+void CFLR::solveParallelWith()
+{
+    std::atomic<size_t> pending(numThreads);
+    std::vector<PartitionSolver *> partitions(numThreads);
+    for (unsigned id = 0; id < numThreads; ++id)
+        partitions[id] = new PartitionSolver(id, partitions, grammar, graph->getNumIndices(), pending);
+
+    std::vector<std::thread> threads;
+    for (auto partition : partitions)
+    {
+        threads.emplace_back([this, partition]() {
+            partition->seed(*graph);
+            partition->run();
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    // write the derived edges back, so that the graph holds what the serial engine would have left
+    crossPartitionEdges = 0;
+    crossPartitionBatches = 0;
+    for (auto partition : partitions)
+    {
+        partition->forEachEdge([&](unsigned src, unsigned dst, EdgeLabel label) {
+            graph->addIndexEdge(src, dst, label);
+        });
+        crossPartitionEdges += partition->sentEdges;
+        crossPartitionBatches += partition->sentBatches;
+        delete partition;
+    }
+}
+
+template void CFLR::solveParallelWith<pointerGrammar>();
@@ -0,0 +1,48 @@
+#!/bin/bash
+# Build the Test-Cases and solve each with every CFL-reachability engine and thread count in CONFIGS: the PT
+# edges must be those of the serial worklist engine, byte for byte.
+#
+#   engines.sh <cflr> <clang> <Test-Cases dir> <work dir>
+#
+# Exits with 77 (skipped) if clang cannot be run.
+
+CFLR=$(realpath "$1")
+CLANG="$2"
+TEST_DIR=$(realpath "$3")
+WORK_DIR="$4"
+
+CONFIGS=("-cflr-engine=matrix" "-cflr-engine=auto" "-cflr-engine=worklist -cflr-threads=2"
+         "-cflr-engine=worklist -cflr-threads=4")
+
+if ! "$CLANG" --version > /dev/null 2>&1; then
+    echo "clang not found: $CLANG"
+    exit 77
+fi
+mkdir -p "$WORK_DIR" && cd "$WORK_DIR" || exit 1
+
+fail=0
+for cfile in "$TEST_DIR"/*.c; do
+    name=$(basename "$cfile" .c)
+    cp "$cfile" "$name.c"
+    if ! "$CLANG" -O0 -emit-llvm -c "$name.c" -o "$name.bc"; then
+        echo "FAIL $name: cannot compile"
+        fail=1
+        continue
+    fi
+
+    if ! "$CFLR" -cflr-engine=worklist "$name.bc" > "$name.log" 2>&1; then
+        echo "FAIL $name: cflr failed"
+        fail=1
+        continue
+    fi
+    mv "$name.bc.res.txt" "$name.expected"
+
+    for options in "${CONFIGS[@]}"; do
+        rm -f "$name.bc.res.txt"
+        if ! "$CFLR" $options "$name.bc" > "$name.log" 2>&1 || ! cmp -s "$name.bc.res.txt" "$name.expected"; then
+            echo "FAIL $name $options"
+            fail=1
+        fi
+    done
+done
+exit $fail
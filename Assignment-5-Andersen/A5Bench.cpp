@@ -0,0 +1,410 @@
+/**
+ * A5Bench.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+/*
+ * Microbenchmarks of the kernels of runPointerAnalysis, for several points-to set representations
+ * (std::set, sorted vector, the sparse bit-vector PointsTo) and for the worklists.
+ *
+ *   a5bench [--nodes=N] [--objects=M] [--degree=D] [--set-size=S] [--shape=random|chain|tree|star]
+ *           [--seed=X] [--reps=R] [--format=json|csv]
+ *
+ * Kernels:
+ *   insert   insert S random objects into the set of every node
+ *   union    union the set of a random node into the set of every node
+ *   iterate  visit the members of every set
+ *   solve    propagate Addr seeds along the copy edges of a synthetic graph to a fixpoint (FIFO WorkList)
+ *   worklist push every node of a random sequence with duplicates, then pop all
+ *   dense-union, dense-intersects, dense-popcount
+ *            the word kernels of BitKernels on N pairs of dense bit arrays of M bits (a hub node's set), once
+ *            per instruction set the CPU supports
+ * Each kernel runs R times; one record per (kernel, representation) holds the minimum and median time.
+ * The checksum must agree between the set representations of a kernel.
+ */
+
+namespace
+{
+
+struct BenchConfig
+{
+    unsigned nodes = 10000;
+    unsigned objects = 2000;
+    unsigned degree = 2;
+    unsigned setSize = 16;
+    std::string shape = "random";
+    unsigned seed = 1;
+    unsigned reps = 5;
+    std::string format = "json";
+};
+
+/// A synthetic constraint graph: Addr seeds and copy edges
+struct SyntheticGraph
+{
+    std::vector<std::pair<unsigned, unsigned>> addrEdges;   ///< (object, node)
+    std::vector<std::vector<unsigned>> copySuccs;           ///< node -> copy successors
+};
+
+SyntheticGraph makeGraph(const BenchConfig &config)
+{
+    SyntheticGraph graph;
+    graph.copySuccs.resize(config.nodes);
+    std::mt19937 rng(config.seed);
+    auto randomNode = [&]() { return (unsigned) (rng() % config.nodes); };
+
+    // roughly one node in eight takes the address of an object
+    for (unsigned n = 0; n < config.nodes; n += 8)
+        graph.addrEdges.emplace_back((unsigned) (rng() % config.objects), n);
+
+    for (unsigned n = 0; n < config.nodes; ++n)
+    {
+        for (unsigned d = 0; d < config.degree; ++d)
+        {
+            unsigned succ;
+            if (config.shape == "chain")
+                succ = n + 1 + d < config.nodes ? n + 1 + d : randomNode();
+            else if (config.shape == "tree")
+                succ = n * config.degree + d + 1 < config.nodes ? n * config.degree + d + 1 : randomNode();
+            else if (config.shape == "star")
+                succ = d == 0 ? 0 : randomNode();   // every node also feeds node 0, which has a huge set
+            else
+                succ = randomNode();
+            if (succ != n)
+                graph.copySuccs[n].push_back(succ);
+        }
+    }
+    return graph;
+}
+
+/// std::set<unsigned>, the representation the assignment started with
+struct StdSetRepr
+{
+    using Set = std::set<unsigned>;
+    static constexpr const char *name = "std::set";
+
+    static inline bool insert(Set &set, unsigned id)
+    { return set.insert(id).second; }
+
+    static inline bool unionWith(Set &dst, const Set &src)
+    {
+        auto oldSize = dst.size();
+        dst.insert(src.begin(), src.end());
+        return dst.size() != oldSize;
+    }
+};
+
+/// Sorted std::vector<unsigned>
+struct SortedVectorRepr
+{
+    using Set = std::vector<unsigned>;
+    static constexpr const char *name = "sorted-vector";
+
+    static inline bool insert(Set &set, unsigned id)
+    {
+        auto it = std::lower_bound(set.begin(), set.end(), id);
+        if (it != set.end() && *it == id)
+            return false;
+        set.insert(it, id);
+        return true;
+    }
+
+    static inline bool unionWith(Set &dst, const Set &src)
+    {
+        if (std::includes(dst.begin(), dst.end(), src.begin(), src.end()))
+            return false;
+        Set merged;
+        merged.reserve(dst.size() + src.size());
+        std::set_union(dst.begin(), dst.end(), src.begin(), src.end(), std::back_inserter(merged));
+        dst.swap(merged);
+        return true;
+    }
+};
+
+/// The sparse bit-vector used by the solver
+struct SparseBitVectorRepr
+{
+    using Set = PointsTo;
+    static constexpr const char *name = "sparse-bitvector";
+
+    static inline bool insert(Set &set, unsigned id)
+    { return set.insert(id); }
+
+    static inline bool unionWith(Set &dst, const Set &src)
+    { return dst.unionWith(src); }
+};
+
+struct Record
+{
+    std::string kernel;
+    std::string repr;
+    double minNs;
+    double medianNs;
+    uint64_t checksum;
+};
+
+/// Run f config.reps times; f returns a checksum
+template<class F>
+Record measure(const BenchConfig &config, const std::string &kernel, const std::string &repr, F f)
+{
+    std::vector<double> times;
+    uint64_t checksum = 0;
+    for (unsigned r = 0; r < config.reps; ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        checksum = f();
+        times.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return {kernel, repr, times.front(), times[times.size() / 2], checksum};
+}
+
+template<class Repr>
+uint64_t sumMembers(const std::vector<typename Repr::Set> &sets)
+{
+    uint64_t sum = 0;
+    for (auto &set : sets)
+    {
+        for (auto id : set)
+            sum += id;
+    }
+    return sum;
+}
+
+template<class Repr>
+void benchSets(const BenchConfig &config, const SyntheticGraph &graph, std::vector<Record> &records)
+{
+    using Set = typename Repr::Set;
+
+    // the same random members for every representation
+    std::vector<unsigned> members(config.nodes * config.setSize);
+    std::mt19937 rng(config.seed);
+    for (auto &id : members)
+        id = rng() % config.objects;
+
+    auto build = [&]() {
+        std::vector<Set> sets(config.nodes);
+        for (unsigned n = 0; n < config.nodes; ++n)
+        {
+            for (unsigned k = 0; k < config.setSize; ++k)
+                Repr::insert(sets[n], members[n * config.setSize + k]);
+        }
+        return sets;
+    };
+
+    records.push_back(measure(config, "insert", Repr::name, [&]() {
+        return sumMembers<Repr>(build());
+    }));
+
+    std::vector<Set> filled = build();
+    records.push_back(measure(config, "union", Repr::name, [&]() {
+        std::vector<Set> sets = filled;
+        uint64_t changed = 0;
+        for (unsigned n = 0; n < config.nodes; ++n)
+            changed += Repr::unionWith(sets[n], filled[(n * 7 + 1) % config.nodes]);
+        return changed;
+    }));
+
+    records.push_back(measure(config, "iterate", Repr::name, [&]() {
+        return sumMembers<Repr>(filled);
+    }));
+
+    records.push_back(measure(config, "solve", Repr::name, [&]() {
+        std::vector<Set> pts(config.nodes);
+        WorkList<unsigned> workList;
+        for (auto &edge : graph.addrEdges)
+        {
+            Repr::insert(pts[edge.second], edge.first);
+            workList.push(edge.second);
+        }
+        while (!workList.empty())
+        {
+            auto p = workList.pop();
+            for (auto x : graph.copySuccs[p])
+            {
+                if (Repr::unionWith(pts[x], pts[p]))
+                    workList.push(x);
+            }
+        }
+        uint64_t total = 0;
+        for (auto &set : pts)
+            total += std::distance(set.begin(), set.end());
+        return total;
+    }));
+}
+
+void benchWorkLists(const BenchConfig &config, std::vector<Record> &records)
+{
+    // a push sequence in which every node appears about four times
+    std::vector<unsigned> sequence(config.nodes * 4);
+    std::mt19937 rng(config.seed);
+    for (auto &id : sequence)
+        id = rng() % config.nodes;
+
+    records.push_back(measure(config, "worklist", "WorkList<unsigned>", [&]() {
+        WorkList<unsigned> workList;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < sequence.size(); ++i)
+        {
+            workList.push(sequence[i]);
+            if (i % 2)
+                sum += workList.pop();
+        }
+        while (!workList.empty())
+            sum += workList.pop();
+        return sum;
+    }));
+
+    for (auto policy : {WorkListPolicy::FIFO, WorkListPolicy::LIFO, WorkListPolicy::LRF})
+    {
+        std::string name = std::string("NodeWorkList-") + NodeWorkList::policyName(policy);
+        records.push_back(measure(config, "worklist", name, [&]() {
+            NodeWorkList workList(policy);
+            uint64_t sum = 0;
+            for (size_t i = 0; i < sequence.size(); ++i)
+            {
+                workList.push(sequence[i]);
+                if (i % 2)
+                    sum += workList.pop();
+            }
+            while (!workList.empty())
+                sum += workList.pop();
+            return sum;
+        }));
+    }
+}
+
+void benchKernels(const BenchConfig &config, std::vector<Record> &records)
+{
+    // two pools of N dense arrays; every array holds about half of the M objects
+    size_t n = (config.objects + PointsTo::WORD_BITS - 1) / PointsTo::WORD_BITS;
+    std::vector<BitKernels::Word> lhs(config.nodes * n), rhs(config.nodes * n);
+    std::mt19937_64 rng(config.seed);
+    for (size_t i = 0; i < lhs.size(); ++i)
+    {
+        lhs[i] = rng();
+        // rhs is disjoint from lhs, so that intersects scans every word
+        rhs[i] = rng() & ~lhs[i];
+    }
+
+    for (auto isa : {"scalar", "avx2", "avx512"})
+    {
+        if (!selectBitKernels(isa))
+            continue;
+        const BitKernels &kernels = bitKernels();
+        std::string name = std::string("words-") + isa;
+
+        records.push_back(measure(config, "dense-union", name, [&]() {
+            std::vector<BitKernels::Word> dst = lhs;
+            uint64_t changed = 0;
+            for (unsigned k = 0; k < config.nodes; ++k)
+                changed += kernels.unionWords(&dst[k * n], &rhs[k * n], n);
+            return changed + kernels.popcountWords(dst.data(), dst.size());
+        }));
+        records.push_back(measure(config, "dense-intersects", name, [&]() {
+            uint64_t shared = 0;
+            for (unsigned k = 0; k < config.nodes; ++k)
+                shared += kernels.intersectsWords(&lhs[k * n], &rhs[k * n], n);
+            return shared;
+        }));
+        records.push_back(measure(config, "dense-popcount", name, [&]() {
+            return (uint64_t) kernels.popcountWords(lhs.data(), lhs.size());
+        }));
+    }
+    selectBitKernels("auto");
+}
+
+bool parseArgs(int argc, char **argv, BenchConfig &config)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos)
+            return false;
+        std::string name = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+
+        if (name == "shape")
+            config.shape = value;
+        else if (name == "format")
+            config.format = value;
+        else
+        {
+            char *end;
+            unsigned long number = std::strtoul(value.c_str(), &end, 10);
+            if (end == value.c_str() || *end != '\0' || number > UINT_MAX)
+                return false;
+            // a seed may be zero, and so may the degree (no copy edges); sizes and repetitions may not
+            if (number == 0 && name != "seed" && name != "degree")
+                return false;
+            if (name == "nodes")
+                config.nodes = number;
+            else if (name == "objects")
+                config.objects = number;
+            else if (name == "degree")
+                config.degree = number;
+            else if (name == "set-size")
+                config.setSize = number;
+            else if (name == "seed")
+                config.seed = number;
+            else if (name == "reps")
+                config.reps = number;
+            else
+                return false;
+        }
+    }
+    return (config.shape == "random" || config.shape == "chain" || config.shape == "tree" ||
+            config.shape == "star") && (config.format == "json" || config.format == "csv");
+}
+
+}
+
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config))
+    {
+        std::cerr << "usage: a5bench [--nodes=N] [--objects=M] [--degree=D] [--set-size=S] "
+                     "[--shape=random|chain|tree|star] [--seed=X] [--reps=R] [--format=json|csv]\n";
+        return 1;
+    }
+
+    SyntheticGraph graph = makeGraph(config);
+    std::vector<Record> records;
+    benchSets<StdSetRepr>(config, graph, records);
+    benchSets<SortedVectorRepr>(config, graph, records);
+    benchSets<SparseBitVectorRepr>(config, graph, records);
+    benchWorkLists(config, records);
+    benchKernels(config, records);
+
+    // one JSON object per line, or CSV with a header row
+    if (config.format == "csv")
+        std::cout << "kernel,repr,shape,nodes,objects,degree,set_size,reps,min_ns,median_ns,checksum\n";
+    for (auto &record : records)
+    {
+        if (config.format == "csv")
+        {
+            std::cout << record.kernel << "," << record.repr << "," << config.shape << "," << config.nodes << ","
+                      << config.objects << "," << config.degree << "," << config.setSize << "," << config.reps
+                      << "," << (uint64_t) record.minNs << "," << (uint64_t) record.medianNs << ","
+                      << record.checksum << "\n";
+        }
+        else
+        {
+            std::cout << "{\"kernel\": \"" << record.kernel << "\", \"repr\": \"" << record.repr
+                      << "\", \"shape\": \"" << config.shape << "\", \"nodes\": " << config.nodes
+                      << ", \"objects\": " << config.objects << ", \"degree\": " << config.degree
+                      << ", \"set_size\": " << config.setSize << ", \"reps\": " << config.reps
+                      << ", \"min_ns\": " << (uint64_t) record.minNs << ", \"median_ns\": "
+                      << (uint64_t) record.medianNs << ", \"checksum\": " << record.checksum << "}\n";
+        }
+    }
+    return 0;
+}
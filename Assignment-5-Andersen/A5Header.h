@@ -7,9 +7,116 @@
 #define ANSWERS_A5HEADER_H
 
 #include "SVF-LLVM/SVFIRBuilder.h"
+#include "PointsTo.h"
+#include "PointsToTable.h"
+#include "ResultStore.h"
+#include "PhaseProfile.h"
+#include "ConstraintCSR.h"
+#include "Steensgaard.h"
+#include "FanOutPool.h"
+#include "NodeWorkList.h"
+#include "AliasCache.h"
+#include <memory>
+#include <set>
+#include <tuple>
+
+/**
+ * Mutable point-to sets of all nodes, stored in a dense vector indexed by node ID.
+ * Accessing a node beyond the current size grows the vector.
+ */
+class PTS
+{
+public:
+    /// Get the points-to set of a node, growing the storage if needed.
+    /// Note that growing invalidates references to other sets.
+    inline PointsTo &operator[](unsigned id)
+    {
+        if (id >= sets.size())
+            sets.resize(id + 1);
+        return sets[id];
+    }
+
+    /// Get the points-to set of a node, or an empty set if the node has none
+    inline const PointsTo &at(unsigned id) const
+    {
+        static const PointsTo emptySet;
+        return id < sets.size() ? sets[id] : emptySet;
+    }
+
+    /// Reserve room for node IDs below n so that accessing them does not move other sets
+    inline void reserve(unsigned n)
+    {
+        if (n > sets.size())
+            sets.resize(n);
+    }
+
+    inline unsigned size() const
+    { return sets.size(); }
+
+    /// Bytes held by the sets; walks all of them
+    size_t memoryBytes() const
+    {
+        size_t bytes = sets.capacity() * sizeof(PointsTo);
+        for (auto &set : sets)
+            bytes += set.memoryBytes();
+        return bytes;
+    }
+
+private:
+    std::vector<PointsTo> sets;
+};
+
+
+/**
+ * Point-to sets of all nodes, hash-consed: each node holds the ID of a canonical set in a PointsToTable,
+ * so nodes with equal sets share one copy and equal sets have equal IDs.
+ */
+class InternedPTS
+{
+public:
+    /// Get the ID of the set of a node
+    inline unsigned getId(unsigned id) const
+    { return id < ids.size() ? ids[id] : PointsToTable::EMPTY_SET; }
+
+    /// Make setId the set of a node
+    inline void setId(unsigned id, unsigned setId)
+    {
+        if (id >= ids.size())
+            ids.resize(id + 1, PointsToTable::EMPTY_SET);
+        ids[id] = setId;
+    }
+
+    /// Get the point-to set of a node
+    inline const PointsTo &at(unsigned id) const
+    { return table.get(getId(id)); }
+
+    /// Reserve room for node IDs below n, so that setId on them does not move the ID array
+    inline void reserve(unsigned n)
+    {
+        if (n > ids.size())
+            ids.resize(n, PointsToTable::EMPTY_SET);
+    }
+
+    /// Bytes of the ID array; the sets are counted by the table
+    inline size_t memoryBytes() const
+    { return ids.capacity() * sizeof(unsigned); }
+
+    /// Free the sets of the table that no node holds any more, once enough new ones were added
+    /// @return true if a set was freed, so that its ID may now name another set
+    inline bool collect()
+    { return table.wantsCollect(ids.size()) && table.collect(ids) > 0; }
+
+    inline PointsToTable &getTable()
+    { return table; }
+
+    inline const PointsToTable &getTable() const
+    { return table; }
+
+private:
+    PointsToTable table;
+    std::vector<unsigned> ids;  ///< node -> set ID
+};
 
-/// Point-to set
-using PTS = std::map<unsigned, std::set<unsigned>>;
 
 /**
  * FIFO worklist
@@ -58,22 +165,296 @@ protected:
 };
 
 
+/**
+ * Counters of the Andersen solver. The workers of the parallel solver call addPts, so the union counters it
+ * updates are atomic; all other counters are written by the main thread, between rounds.
+ */
+struct SolverStats
+{
+    unsigned duplicateCopyEdges = 0;   ///< store/load-induced copy edges that already existed and were not re-added
+    unsigned long workListPops = 0;    ///< nodes popped from the worklist
+    unsigned parallelRounds = 0;       ///< rounds of the parallel solver
+    unsigned newConstraints = 0;       ///< constraint edges not in the snapshot of an incremental run
+    unsigned demandNodes = 0;          ///< nodes solved in demand-driven mode
+    std::atomic<unsigned long> unions{0};          ///< unions into a points-to set (addPts), by any thread
+    std::atomic<unsigned long> changedUnions{0};   ///< unions that added at least one object
+    std::atomic<unsigned long> finalNodeUnions{0}; ///< unions skipped as the node already held its Steensgaard bound
+    unsigned components = 0;           ///< components of the Steensgaard pre-pass
+    unsigned derivedCopyEdges = 0;     ///< copy edges added for store/load edges in this run
+    unsigned fieldObjects = 0;         ///< field objects created for gep edges in this run
+    unsigned long fieldMemoHits = 0;   ///< field objects found in the (object, offset) memo without asking SVF
+    unsigned collapsedObjects = 0;     ///< objects made field-insensitive (positive-weight cycle or field limit)
+    unsigned long aliasQueries = 0;    ///< mayAlias calls
+    unsigned long aliasCacheHits = 0;  ///< mayAlias calls answered by the cache
+};
+
+
+/// A field object created while solving, and how to create it again: getGepObjVar(base, offset)
+struct FieldObjRecord
+{
+    unsigned fieldObj;
+    unsigned base;
+    SVF::APOffset offset;
+};
+
+/// Key of the field object memo: an object and the offset of a gep on it, with variant geps flagged apart
+struct FieldMemoKey
+{
+    unsigned obj;
+    bool variant;
+    SVF::APOffset offset;   ///< 0 for a variant gep
+
+    inline bool operator==(const FieldMemoKey &other) const
+    { return obj == other.obj && variant == other.variant && offset == other.offset; }
+};
+
+template<>
+struct std::hash<FieldMemoKey>
+{
+    size_t operator()(const FieldMemoKey &key) const
+    {
+        uint64_t h = ((uint64_t) key.obj << 1 | key.variant) * 0x9E3779B97F4A7C15ull;
+        return h ^ ((uint64_t) key.offset + (h >> 29));
+    }
+};
+
+
 /// The Andersen solver
 class Andersen
 {
 public:
-    explicit Andersen(SVF::ConstraintGraph *consg) :
-            consg(consg)
+    explicit Andersen(SVF::ConstraintGraph *consg, WorkListPolicy policy = WorkListPolicy::FIFO,
+                      unsigned threads = 1) :
+            consg(consg), policy(policy), pool(threads > 1 ? new FanOutPool(threads) : nullptr)
     {}
 
+    /**
+     * Bound the field objects created while solving: with collapsePositiveWeightCycles, an object reaching a
+     * gep with a non-zero offset on a copy/gep cycle (pointer arithmetic in a loop) becomes field-insensitive;
+     * with maxFieldsPerObject > 0, so does an object that would get more field objects than that.
+     * Positive-weight cycles are found by mergePointerEquivalents.
+     */
+    inline void setFieldLimits(bool collapsePositiveWeightCycles, unsigned maxFieldsPerObject)
+    {
+        collapsePWC = collapsePositiveWeightCycles;
+        maxFields = maxFieldsPerObject;
+    }
+    /**
+     * Keep the points-to sets and the per-node structures of the solver within about budgetBytes: past it, the
+     * least recently used sets are spilled to a file in dir and faulted back in when the solver reads them again
+     * @return false if the spill file cannot be created
+     */
+    inline bool setMemoryBudget(size_t budgetBytes, const std::string &dir)
+    { return pts.getTable().enableSpill(budgetBytes, dir); }
+    /**
+     * Use the result of a Steensgaard pre-pass in runPointerAnalysis: a node whose Steensgaard set is one object
+     * is final once it holds it
+     */
+    inline void setSteensgaard(const Steensgaard *steensgaard)
+    { steens = steensgaard; }
+    /// Merge pointers that must have identical points-to sets, before solving
+    void mergePointerEquivalents();
     /// Run pointer analysis
     void runPointerAnalysis();
+    /**
+     * Run pointer analysis from the state saved by saveSnapshot, propagating only the constraints added since.
+     * Node IDs of the constraint graph are expected to be stable between the runs; field objects created
+     * while solving are recreated and renumbered.
+     * Falls back to a full run if the snapshot cannot be read, or if a constraint it solved was removed.
+     */
+    void runIncrementalAnalysis(const std::string &fname);
+    /// Save the solved state: the points-to sets, the derived copy edges and the constraints solved
+    bool saveSnapshot(const std::string &fname);
+    /// Check whether every node has the same points-to set as in other
+    bool samePointsTo(const Andersen &other) const;
+    /**
+     * Demand-driven mode: compute the points-to set of node only, solving just the constraints it depends on.
+     * The solved part is kept, so later queries reuse it. Do not mix with runPointerAnalysis.
+     */
+    const PointsTo &queryPointsTo(unsigned node);
+    /// Build the reverse (object -> pointers) index used by pointedBy and aliasPairs; call after solving
+    void buildAliasIndex();
+    /// Points-to set of node after solving
+    inline const PointsTo &pointsTo(unsigned node)
+    { return pts.at(getRep(node)); }
+    /// Nodes whose points-to set holds obj
+    const PointsTo &pointedBy(unsigned obj) const;
+    /// Check whether p and q may point to a common object
+    bool mayAlias(unsigned p, unsigned q);
+    /// All pairs (p, q) with p < q of the given pointers that may alias, found through the reverse index
+    std::vector<std::pair<unsigned, unsigned>> aliasPairs(const std::vector<unsigned> &pointers);
     /// Dump results into a file
     void dumpResult();
+    /// Dump results into a memory-mappable binary file (see ResultStore.h), optionally varint/delta encoded
+    void dumpBinaryResult(bool compress);
+    /// Print solver statistics
+    void printStats();
+    /// Write the phases of profile, the solver counters and set sizes, and the peak RSS to a JSON file
+    bool dumpReport(const std::string &fname, const PhaseProfile &profile);
+
+    inline const SolverStats &getStats() const
+    { return stats; }
 
 protected:
+    /**
+     * Add the set objsId (an ID in the points-to table) to pts(id), recording the newly added objects in the
+     * delta set of id
+     * @return true if pts(id) changed
+     */
+    bool addPts(unsigned id, unsigned objsId);
+    inline bool addPts(unsigned id, const PointsTo &objs)
+    { return addPts(id, pts.getTable().intern(objs)); }
+    /// Propagate the whole of pts(src) to dst, e.g. along a newly added copy edge
+    bool propagate(unsigned src, unsigned dst);
+    /// Add a copy edge derived while solving to the constraint graph and to its flat snapshot
+    void addCopyEdge(unsigned src, unsigned dst);
+
+    /// Index the copy edges of the graph and make room for its nodes
+    void indexConstraints();
+    /// Add the objects of the Addr edges to the sets of their destinations
+    void seedAddrEdges(NodeWorkList &workList);
+    /// Solve from the state in workList, pts and deltaPts
+    void solve(NodeWorkList &workList);
+    /**
+     * Between two pops: let the points-to table spill sets if the memory counted against the budget is over
+     * it. Besides the table, that counts the per-node structures of the solver, measured every so many
+     * checkpoints.
+     */
+    void checkpoint();
+    /// Compact the CSR and checkpoint once enough copy edges were derived, or nodes popped, since the last time
+    void solverCheckpoint();
+    /// Run the solver of the policy and thread count until the worklist is empty
+    void runSolver(NodeWorkList &workList);
+    /**
+     * Get the field object of o through gepEdge, memoized by (o, offset); logs it in fieldObjLog if it is created
+     * while solving. Returns the field-insensitive object if o is (or becomes) collapsed.
+     */
+    unsigned getFieldObj(unsigned o, const SVF::GepCGEdge *gepEdge);
+    /// Same, with the offset of gepEdge known (ConstraintCSR::VARIANT_GEP for a variant gep)
+    unsigned getFieldObj(unsigned o, const SVF::GepCGEdge *gepEdge, SVF::APOffset offset);
+    /**
+     * The field object getFieldObj would return, if it returns it without creating or collapsing anything;
+     * ConstraintCSR::NO_NODE otherwise. Changes nothing, so that worker threads can call it concurrently.
+     */
+    unsigned findFieldObj(unsigned o, const SVF::GepCGEdge *gepEdge, SVF::APOffset offset) const;
+    /// Make the base object of o field-insensitive; its known field objects are merged by mergeCollapsedFields
+    unsigned collapseObject(unsigned o);
+    /// Merge the field objects of the objects collapsed since the last call into their base object
+    /// @return the representatives whose sets changed
+    std::vector<unsigned> mergeCollapsedFields();
+
+    inline bool isActive(unsigned id) const
+    { return id < activeNodes.size() && activeNodes[id]; }
+    /// Demand-driven mode: make root and the nodes its set depends on part of the solved subgraph
+    void activate(unsigned root, NodeWorkList &workList);
+
+    /// Pop nodes until the worklist is empty, for all policies but WAVE
+    void solveWorkList(NodeWorkList &workList);
+    /// Solve in waves: copy/gep propagation in topological order, then the store/load constraints
+    void solveWaves(NodeWorkList &workList);
+    /// Solve with several threads, in rounds separated by the updates of the constraint graph
+    void solveParallel(NodeWorkList &workList);
+    /// Resolve the store and load constraints of rep's members for the objects in delta
+    void processComplexConstraints(unsigned rep, const PointsTo &delta, NodeWorkList &workList);
+    /**
+     * Propagate delta along the copy and gep edges of rep's members
+     * @param cycleCandidates if not null, receives copy targets whose sets now equal pts(rep)
+     */
+    void processSimpleConstraints(unsigned rep, const PointsTo &delta, NodeWorkList &workList,
+                                  std::vector<unsigned> *cycleCandidates);
+    /// Collapse all copy cycles and give every representative its topological rank in workList
+    void rankNodes(NodeWorkList &workList);
+
+    /// Collect the nodes to report: those the plain worklist algorithm would visit or write to
+    void collectReportedNodes();
+
+    /// Key of a copy edge in copyEdgeIndex
+    static inline uint64_t edgeKey(unsigned src, unsigned dst)
+    { return ((uint64_t) src << 32) | dst; }
+
+    inline bool isPruned(unsigned id) const
+    { return id < prunedNodes.size() && prunedNodes[id]; }
+
+    /// Get the representative of a node that may have been merged into a cycle
+    unsigned getRep(unsigned id);
+    /// Same as getRep but without path compression, so that worker threads can call it concurrently
+    inline unsigned findRep(unsigned id) const
+    {
+        while (id < repMap.size() && repMap[id] != id)
+            id = repMap[id];
+        return id;
+    }
+    /// Merge node n (and the nodes already merged into it) into rep
+    void mergeNode(unsigned rep, unsigned n);
+    /**
+     * Detect the copy cycles reachable from roots (Tarjan) and collapse each one into a single node
+     * @param topoOrder if not null, receives the visited representatives in topological order
+     * @return the representatives of the collapsed cycles
+     */
+    std::vector<unsigned> collapseCycles(const std::vector<unsigned> &roots,
+                                         std::vector<unsigned> *topoOrder = nullptr);
+
+    /// Apply f to rep and every node merged into it
+    template<class F>
+    void forEachMember(unsigned rep, F f)
+    {
+        f(rep);
+        auto subIt = subNodes.find(rep);
+        if (subIt != subNodes.end())
+        {
+            for (auto n : subIt->second)
+                f(n);
+        }
+    }
+
     SVF::ConstraintGraph *consg;
-    PTS pts;
+    ConstraintCSR csr;      ///< flat copy of the edges of consg walked by the solver
+    WorkListPolicy policy;
+    std::unique_ptr<FanOutPool> pool;   ///< threads of the parallel mode, null with one thread
+    const Steensgaard *steens = nullptr;    ///< pre-pass result bounding the sets, if any
+    InternedPTS pts;
+    PTS deltaPts;   ///< objects added to pts since the node was last processed
+    size_t solverBytes = 0;     ///< bytes of the solver structures besides the table, as last measured
+    unsigned checkpointsUntilMeasure = 0;
+    unsigned long derivedAtCheckpoint = 0;  ///< derived copy edges at the last solverCheckpoint
+    unsigned popsSinceCheckpoint = 0;
+    bool overBudgetReported = false;
+
+    std::vector<unsigned> repMap;   ///< node -> representative, for nodes merged by cycle collapsing
+    std::unordered_map<unsigned, std::vector<unsigned>> subNodes;   ///< representative -> merged nodes
+    std::set<std::pair<unsigned, unsigned>> checkedEdges;   ///< copy edges already used to trigger detection
+
+    std::vector<std::pair<unsigned, unsigned>> derivedEdges;    ///< copy edges resolved from store/load edges
+    unsigned firstFieldObj = 0;     ///< IDs from here on belong to field objects created while solving
+    std::vector<FieldObjRecord> fieldObjLog;    ///< field objects created while solving, in creation order
+    PointsTo loggedFieldObjs;
+    std::unordered_map<FieldMemoKey, unsigned> fieldObjMemo;    ///< (object, offset) -> field object
+
+    bool collapsePWC = false;
+    unsigned maxFields = 0;     ///< maximum number of field objects per object, 0 for no limit
+    /// (src, dst, offset) of the gep edges with a non-zero offset on a copy/gep cycle: geps of other offsets
+    /// may join the same two nodes
+    std::set<std::tuple<unsigned, unsigned, SVF::APOffset>> pwcGepEdges;
+    std::unordered_map<unsigned, unsigned> baseOf;  ///< object -> its base object, for the objects seen by geps
+    std::unordered_map<unsigned, std::vector<unsigned>> fieldsOfBase;  ///< base object -> objects seen by geps
+    std::unordered_map<unsigned, unsigned> collapsedObjs;   ///< object -> field-insensitive object it maps to
+    std::vector<unsigned> pendingCollapses;     ///< collapsed base objects whose fields are not merged yet
+
+    bool demandDriven = false;
+    std::unique_ptr<Steensgaard> storeAliases;  ///< tells which stores may write to an object (demand-driven)
+    std::unordered_map<unsigned, std::vector<unsigned>> storePointersOf;   ///< class -> inactive pointers storing to it
+    std::vector<bool> activeNodes;      ///< nodes whose sets are solved in demand-driven mode
+    std::unordered_map<unsigned, std::vector<unsigned>> pendingStores;  ///< inactive object -> sources stored to it
+
+    std::unordered_set<uint64_t> copyEdgeIndex;    ///< copy edges in the graph, plus those resolved for pruned nodes
+    std::vector<bool> prunedNodes;  ///< nodes that no Addr edge reaches, so their points-to sets stay empty
+    PointsTo visitedNodes;      ///< empty-set nodes that the plain worklist algorithm would still push
+    PointsTo reportedNodes;     ///< nodes written to the result file
+
+    std::vector<PointsTo> pointedByIndex;   ///< object -> nodes whose set holds it
+    AliasCache aliasCache{4096};            ///< recent mayAlias answers
+
+    SolverStats stats;
 };
 
 
@@ -16,13 +16,130 @@ void Andersen::dumpResult()
     }
 
     // Write S-edges
-    for (auto &pointerIt : pts)
+    for (auto pointer : reportedNodes)
     {
-        outFile << pointerIt.first << " points to: {";
-        for (auto pointee : pointerIt.second)
+        checkpoint();
+        outFile << pointer << " points to: {";
+        // merged nodes share the set of their representative
+        for (auto pointee : pts.at(getRep(pointer)))
         {
             outFile << pointee << ", ";
         }
         outFile << "}\n";
     }
-}
\ No newline at end of file
+}
+
+
+void Andersen::dumpBinaryResult(bool compress)
+{
+    std::string fname = SVF::PAG::getPAG()->getModuleIdentifier() + ".res.bin";
+
+    // interned sets are already deduplicated: number the distinct ones in order of first use
+    ResultStoreData data;
+    data.sets.emplace_back();
+    std::unordered_map<unsigned, unsigned> setIndex = {{PointsToTable::EMPTY_SET, 0}};
+    for (auto pointer : reportedNodes)
+    {
+        checkpoint();
+        unsigned setId = pts.getId(getRep(pointer));
+        auto it = setIndex.find(setId);
+        if (it == setIndex.end())
+        {
+            it = setIndex.emplace(setId, data.sets.size()).first;
+            const PointsTo &objs = pts.getTable().get(setId);
+            data.sets.emplace_back(objs.begin(), objs.end());
+        }
+        data.nodes.emplace_back(pointer, it->second);
+    }
+
+    writeResultStore(fname, data, compress);
+}
+
+
+void Andersen::printStats()
+{
+    SVF::SVFUtil::outs() << "################ (Andersen statistics) ################\n";
+    SVF::SVFUtil::outs() << "DuplicateCopyEdges\t" << stats.duplicateCopyEdges << "\n";
+    SVF::SVFUtil::outs() << "WorkListPolicy\t" << NodeWorkList::policyName(policy) << "\n";
+    SVF::SVFUtil::outs() << "SetKernels\t" << bitKernels().isa << "\n";
+    SVF::SVFUtil::outs() << "WorkListPops\t" << stats.workListPops << "\n";
+    SVF::SVFUtil::outs() << "InternedSets\t" << pts.getTable().size() << "\n";
+    SVF::SVFUtil::outs() << "CollectedSets\t" << pts.getTable().getCollected() << "\n";
+    SVF::SVFUtil::outs() << "UnionMemoHits\t" << pts.getTable().getMemoHits() << "\n";
+    SVF::SVFUtil::outs() << "UnionMemoMisses\t" << pts.getTable().getMemoMisses() << "\n";
+    SVF::SVFUtil::outs() << "NewConstraints\t" << stats.newConstraints << "\n";
+    SVF::SVFUtil::outs() << "DemandNodes\t" << stats.demandNodes << "\n";
+    SVF::SVFUtil::outs() << "Unions\t" << stats.unions << "\n";
+    SVF::SVFUtil::outs() << "ChangedUnions\t" << stats.changedUnions << "\n";
+    SVF::SVFUtil::outs() << "DerivedCopyEdges\t" << stats.derivedCopyEdges << "\n";
+    SVF::SVFUtil::outs() << "FieldObjects\t" << stats.fieldObjects << "\n";
+    SVF::SVFUtil::outs() << "FieldMemoHits\t" << stats.fieldMemoHits << "\n";
+    SVF::SVFUtil::outs() << "CollapsedObjects\t" << stats.collapsedObjects << "\n";
+    SVF::SVFUtil::outs() << "SpilledSets\t" << pts.getTable().getSpills() << "\n";
+    SVF::SVFUtil::outs() << "RefaultedSets\t" << pts.getTable().getRefaults() << "\n";
+    SVF::SVFUtil::outs() << "SpillFileBytes\t" << pts.getTable().getSpillFileBytes() << "\n";
+    SVF::SVFUtil::outs() << "PeakResidentSetBytes\t" << pts.getTable().getPeakResidentBytes() << "\n";
+    SVF::SVFUtil::outs() << "PeakBudgetedBytes\t" << pts.getTable().getPeakCountedBytes() << "\n";
+    SVF::SVFUtil::outs() << "AliasQueries\t" << stats.aliasQueries << "\n";
+    SVF::SVFUtil::outs() << "AliasCacheHits\t" << stats.aliasCacheHits << "\n";
+    if (steens)
+    {
+        SVF::SVFUtil::outs() << "SteensgaardComponents\t" << stats.components << "\n";
+        SVF::SVFUtil::outs() << "FinalNodeUnions\t" << stats.finalNodeUnions << "\n";
+    }
+    if (pool)
+    {
+        SVF::SVFUtil::outs() << "Threads\t" << pool->getThreads() << "\n";
+        SVF::SVFUtil::outs() << "ParallelRounds\t" << stats.parallelRounds << "\n";
+    }
+    SVF::SVFUtil::outs() << "#######################################################\n";
+}
+
+
+bool Andersen::dumpReport(const std::string &fname, const PhaseProfile &profile)
+{
+    // set sizes over the nodes with a non-empty set; merged nodes count once per member
+    unsigned largestSet = 0;
+    unsigned long totalSize = 0;
+    unsigned nonEmptySets = 0;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        checkpoint();
+        auto setId = pts.getId(getRep(it->first));
+        if (setId == PointsToTable::EMPTY_SET)
+            continue;
+        auto size = pts.getTable().get(setId).size();
+        largestSet = std::max(largestSet, size);
+        totalSize += size;
+        nonEmptySets++;
+    }
+
+    return profile.writeJson(fname, {
+            {"worklist_pops", stats.workListPops},
+            {"unions", stats.unions},
+            {"changed_unions", stats.changedUnions},
+            {"derived_copy_edges", stats.derivedCopyEdges},
+            {"duplicate_copy_edges", stats.duplicateCopyEdges},
+            {"field_objects", stats.fieldObjects},
+            {"field_memo_hits", stats.fieldMemoHits},
+            {"collapsed_objects", stats.collapsedObjects},
+            {"alias_queries", stats.aliasQueries},
+            {"alias_cache_hits", stats.aliasCacheHits},
+            {"interned_sets", pts.getTable().size()},
+            {"collected_sets", pts.getTable().getCollected()},
+            {"union_memo_hits", pts.getTable().getMemoHits()},
+            {"union_memo_misses", pts.getTable().getMemoMisses()},
+            {"spilled_sets", pts.getTable().getSpills()},
+            {"refaulted_sets", pts.getTable().getRefaults()},
+            {"spill_file_bytes", pts.getTable().getSpillFileBytes()},
+            {"peak_resident_set_bytes", pts.getTable().getPeakResidentBytes()},
+            {"peak_budgeted_bytes", pts.getTable().getPeakCountedBytes()},
+            {"parallel_rounds", stats.parallelRounds},
+            {"demand_nodes", stats.demandNodes},
+            {"steensgaard_components", stats.components},
+            {"final_node_unions", stats.finalNodeUnions},
+            {"non_empty_sets", nonEmptySets},
+            {"largest_set", largestSet},
+            {"average_set_size", nonEmptySets ? (double) totalSize / nonEmptySets : 0.0},
+    });
+}
@@ -0,0 +1,61 @@
+/**
+ * AliasCache.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_ALIASCACHE_H
+#define ANSWERS_ALIASCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+/**
+ * Least-recently-used cache of alias answers, keyed by an ordered pair of interned set IDs
+ */
+class AliasCache
+{
+public:
+    explicit AliasCache(size_t capacity) :
+            capacity(capacity)
+    {}
+
+    /// Look up key; on a hit, the entry becomes the most recently used one
+    bool find(uint64_t key, bool &value)
+    {
+        auto it = index.find(key);
+        if (it == index.end())
+            return false;
+        entries.splice(entries.begin(), entries, it->second);
+        value = it->second->second;
+        return true;
+    }
+
+    /// Insert key, evicting the least recently used entry when full
+    void insert(uint64_t key, bool value)
+    {
+        if (capacity == 0 || index.count(key))
+            return;
+        if (entries.size() == capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+        entries.emplace_front(key, value);
+        index[key] = entries.begin();
+    }
+
+    inline void clear()
+    {
+        entries.clear();
+        index.clear();
+    }
+
+private:
+    size_t capacity;
+    std::list<std::pair<uint64_t, bool>> entries;   ///< most recently used first
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, bool>>::iterator> index;
+};
+
+#endif //ANSWERS_ALIASCACHE_H
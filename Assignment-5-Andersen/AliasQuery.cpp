@@ -0,0 +1,95 @@
+/**
+ * AliasQuery.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+/*
+ * Alias queries on the solved points-to sets.
+ *
+ * Nodes that share an interned set alias without looking at the set. Otherwise mayAlias intersects the two
+ * sparse bit-vectors word by word and stops at the first common word; recent answers are kept in an LRU cache,
+ * since checkers tend to ask about the same pointers again. The reverse index maps each object to the nodes
+ * pointing to it, so that all alias pairs of a group of pointers come from the objects they point to instead
+ * of a test of every pair.
+ */
+
+void Andersen::buildAliasIndex()
+{
+    // nodes are grouped by interned set, so that each distinct set is walked once
+    std::unordered_map<unsigned, std::vector<unsigned>> nodesOfSet;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        auto setId = pts.getId(getRep(it->first));
+        if (setId != PointsToTable::EMPTY_SET)
+            nodesOfSet[setId].push_back(it->first);
+    }
+
+    pointedByIndex.clear();
+    for (auto &it : nodesOfSet)
+    {
+        for (auto obj : pts.getTable().get(it.first))
+        {
+            if (obj >= pointedByIndex.size())
+                pointedByIndex.resize(obj + 1);
+            for (auto n : it.second)
+                pointedByIndex[obj].insert(n);
+        }
+    }
+    aliasCache.clear();
+}
+
+
+const PointsTo &Andersen::pointedBy(unsigned obj) const
+{
+    static const PointsTo empty;
+    return obj < pointedByIndex.size() ? pointedByIndex[obj] : empty;
+}
+
+
+bool Andersen::mayAlias(unsigned p, unsigned q)
+{
+    stats.aliasQueries++;
+    auto lhs = pts.getId(getRep(p));
+    auto rhs = pts.getId(getRep(q));
+    if (lhs == PointsToTable::EMPTY_SET || rhs == PointsToTable::EMPTY_SET)
+        return false;
+    if (lhs == rhs)
+        return true;
+
+    bool alias;
+    auto key = edgeKey(std::min(lhs, rhs), std::max(lhs, rhs));
+    if (aliasCache.find(key, alias))
+    {
+        stats.aliasCacheHits++;
+        return alias;
+    }
+    alias = pts.getTable().get(lhs).intersects(pts.getTable().get(rhs));
+    aliasCache.insert(key, alias);
+    return alias;
+}
+
+
+std::vector<std::pair<unsigned, unsigned>> Andersen::aliasPairs(const std::vector<unsigned> &pointers)
+{
+    PointsTo group;
+    for (auto p : pointers)
+        group.insert(p);
+
+    std::vector<std::pair<unsigned, unsigned>> pairs;
+    for (auto p : group)
+    {
+        // every node that shares an object with p
+        PointsTo aliases;
+        for (auto obj : pts.at(getRep(p)))
+            aliases.unionWith(pointedBy(obj));
+
+        for (auto q : aliases)
+        {
+            if (q > p && group.test(q))
+                pairs.emplace_back(p, q);
+        }
+    }
+    return pairs;
+}
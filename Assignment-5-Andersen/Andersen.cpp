@@ -5,261 +5,910 @@
 
 #include "A5Header.h"
 
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
 using namespace llvm;
 using namespace std;
 
-int main(int argc, char** argv)
+static Option<bool> PrintStats("andersen-stat", "Print statistics of the Andersen solver", false);
+static Option<std::string> WorkListOrder("andersen-wl", "Worklist policy of the Andersen solver: fifo, lifo, lrf, topo or wave",
+                                         "fifo");
+static Option<unsigned> Threads("andersen-threads", "Number of threads of the Andersen solver (the worklist policy "
+                                                   "applies to a single thread only)", 1);
+static Option<std::string> LoadSnapshot("andersen-load", "Start from the solver state saved in this file and only "
+                                                         "propagate the constraints added since", "");
+static Option<std::string> SaveSnapshot("andersen-save", "Save the solver state to this file after solving", "");
+static Option<bool> BinaryResult("andersen-binary", "Also write the result as a memory-mappable binary file "
+                                                  "(<module>.res.bin), to be read with andersen-query", false);
+static Option<bool> VarintResult("andersen-varint", "Varint/delta encode the sets of the binary result file", false);
+static Option<std::string> DemandQueries("andersen-demand", "Only compute the points-to sets of these pointers "
+                                                           "(comma-separated node IDs or value names)", "");
+static Option<bool> CheckIncremental("andersen-check-incremental", "After an incremental run, solve again from "
+                                                                   "scratch and compare the points-to sets", false);
+static Option<std::string> ReportFile("andersen-report", "Write the wall/CPU time of each phase, the solver "
+                                                         "counters and the peak RSS to this JSON file", "");
+static Option<bool> CollapsePWC("andersen-collapse-pwc", "Make objects that reach pointer arithmetic in a loop "
+                                                          "(a positive-weight gep cycle) field-insensitive", false);
+static Option<unsigned> MaxFields("andersen-max-fields", "Make an object field-insensitive once it has more field "
+                                                        "objects than this (0 for no limit)", 0);
+static Option<std::string> AliasQueries("andersen-alias", "After solving, answer may-alias queries given as "
+                                                         "comma-separated pairs of node IDs p:q", "");
+static Option<std::string> AliasPairs("andersen-alias-pairs", "After solving, list the may-alias pairs among these "
+                                                             "comma-separated node IDs, or among 'all' nodes", "");
+static Option<std::string> BatchManifest("andersen-batch", "Analyze each bitcode file listed in this manifest "
+                                                           "(one path per line) in its own worker process", "");
+static Option<unsigned> BatchJobs("andersen-jobs", "Maximum number of modules analyzed at the same time in batch "
+                                                   "mode", 1);
+static Option<std::string> MemoryBudget("andersen-memory-budget", "Keep the points-to sets and the solver "
+                                                                  "structures within this many bytes, e.g. 512K, "
+                                                                  "64M or 2G (a plain number is in MB), by spilling "
+                                                                  "the least recently used sets to disk (0 for no "
+                                                                  "limit)", "0");
+static Option<std::string> SpillDir("andersen-spill-dir", "Directory of the spill file of -andersen-memory-budget",
+                                    "/tmp");
+static Option<std::string> Engine("andersen-engine", "Analysis to run: andersen, steens (unification-based "
+                                                   "Steensgaard only, fast and imprecise) or steens-andersen "
+                                                   "(Andersen seeded by Steensgaard)", "andersen");
+static Option<std::string> SimdKernels("andersen-simd", "Word kernels of the points-to set operations: auto (the "
+                                                        "widest the CPU supports), scalar, avx2 or avx512", "auto");
+
+/// Parse a byte count with an optional K, M or G suffix; without one, the number is in MB
+static bool parseBudget(const std::string &text, size_t &bytes)
 {
-    auto moduleNameVec =
-            OptionBase::parseOptions(argc, argv, "Whole Program Points-to Analysis",
-                                     "[options] <input-bitcode...>");
+    char *end;
+    errno = 0;
+    unsigned long long number = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str() || text[0] == '-' || errno == ERANGE)
+        return false;
+    std::string unit = end;
+    unsigned shift;
+    if (unit == "K" || unit == "k")
+        shift = 10;
+    else if (unit.empty() || unit == "M" || unit == "m")
+        shift = 20;
+    else if (unit == "G" || unit == "g")
+        shift = 30;
+    else
+        return false;
+    // a count that does not fit in size_t once scaled is rejected rather than wrapped around
+    if (number > (SIZE_MAX >> shift))
+        return false;
+    bytes = (size_t) number << shift;
+    return true;
+}
 
+/// Analyze one program (the modules in moduleNameVec are linked into one) and write its result files
+static int analyzeModule(const std::vector<std::string> &moduleNameVec, WorkListPolicy policy,
+                         const std::string &reportFile)
+{
+    PhaseProfile profile;
+    profile.start("buildSVFModule");
     SVF::LLVMModuleSet::buildSVFModule(moduleNameVec);
+    // the module set is released on every way out, after the solvers that refer to it
+    struct ModuleSetRelease
+    {
+        ~ModuleSetRelease()
+        { SVF::LLVMModuleSet::releaseLLVMModuleSet(); }
+    } release;
 
+    profile.start("buildSVFIR");
     SVF::SVFIRBuilder builder;
     auto pag = builder.build();
+    profile.start("buildConstraintGraph");
     auto consg = new SVF::ConstraintGraph(pag);
+    profile.start("dumpConstraintGraph");
     consg->dump();
 
-    Andersen andersen(consg);
+    Steensgaard steens(consg);
+    if (Engine() != "andersen")
+    {
+        profile.start("steensgaard");
+        steens.analyze();
+        if (Engine() == "steens")
+        {
+            profile.start("dumpResult");
+            steens.dumpResult();
+            profile.stop();
+            if (PrintStats())
+                steens.printStats();
+            if (!reportFile.empty())
+                steens.dumpReport(reportFile, profile);
+            return 0;
+        }
+    }
 
-    // TODO: complete the following method
-    andersen.runPointerAnalysis();
+    profile.start("mergePointerEquivalents");
+    Andersen andersen(consg, policy, Threads());
+    if (Engine() == "steens-andersen")
+        andersen.setSteensgaard(&steens);
+    andersen.setFieldLimits(CollapsePWC(), MaxFields());
+    size_t budget = 0;
+    if (!parseBudget(MemoryBudget(), budget) || (budget && !andersen.setMemoryBudget(budget, SpillDir())))
+        return 1;
+    andersen.mergePointerEquivalents();
 
+    if (!DemandQueries().empty())
+    {
+        // demand-driven mode: answer the queries on stdout instead of solving the whole graph
+        profile.start("demandQueries");
+        std::stringstream queries(DemandQueries());
+        std::string query;
+        while (std::getline(queries, query, ','))
+        {
+            std::vector<SVF::NodeID> ids;
+            if (!query.empty() && query.find_first_not_of("0123456789") == std::string::npos)
+            {
+                ids.push_back(std::stoul(query));
+            }
+            else
+            {
+                for (auto it = pag->begin(); it != pag->end(); ++it)
+                {
+                    if (it->second->getValueName() == query)
+                        ids.push_back(it->first);
+                }
+            }
+            if (ids.empty())
+                SVF::SVFUtil::errs() << "no node named '" << query << "'\n";
+
+            for (auto id : ids)
+            {
+                if (!consg->hasConstraintNode(id))
+                {
+                    SVF::SVFUtil::errs() << "no constraint node " << id << "\n";
+                    continue;
+                }
+                SVF::SVFUtil::outs() << id << " points to: {";
+                for (auto obj : andersen.queryPointsTo(id))
+                    SVF::SVFUtil::outs() << obj << ", ";
+                SVF::SVFUtil::outs() << "}\n";
+            }
+        }
+
+        profile.stop();
+        if (PrintStats())
+            andersen.printStats();
+        if (!reportFile.empty())
+            andersen.dumpReport(reportFile, profile);
+        return 0;
+    }
+
+    profile.start("solve");
+    if (LoadSnapshot().empty())
+        andersen.runPointerAnalysis();
+    else
+        andersen.runIncrementalAnalysis(LoadSnapshot());
+
+    profile.start("dumpResult");
     andersen.dumpResult();
-    SVF::LLVMModuleSet::releaseLLVMModuleSet();
-	return 0;
+    if (BinaryResult())
+        andersen.dumpBinaryResult(VarintResult());
+    if (!SaveSnapshot().empty())
+        andersen.saveSnapshot(SaveSnapshot());
+    profile.stop();
+
+    if (!AliasQueries().empty() || !AliasPairs().empty())
+    {
+        profile.start("aliasQueries");
+        andersen.buildAliasIndex();
+        std::stringstream queries(AliasQueries());
+        std::string query;
+        while (std::getline(queries, query, ','))
+        {
+            unsigned p, q;
+            char sep;
+            if (!(std::istringstream(query) >> p >> sep >> q) || sep != ':' || !consg->hasConstraintNode(p) ||
+                !consg->hasConstraintNode(q))
+            {
+                SVF::SVFUtil::errs() << "bad alias query '" << query << "', expected p:q with constraint nodes\n";
+                continue;
+            }
+            SVF::SVFUtil::outs() << p << " " << q << (andersen.mayAlias(p, q) ? " MayAlias\n" : " NoAlias\n");
+        }
+
+        if (!AliasPairs().empty())
+        {
+            std::vector<unsigned> pointers;
+            if (AliasPairs() == "all")
+            {
+                for (auto it = consg->begin(); it != consg->end(); it++)
+                    pointers.push_back(it->first);
+            }
+            else
+            {
+                std::stringstream ids(AliasPairs());
+                std::string id;
+                while (std::getline(ids, id, ','))
+                {
+                    if (!id.empty() && id.find_first_not_of("0123456789") == std::string::npos)
+                        pointers.push_back(std::stoul(id));
+                    else
+                        SVF::SVFUtil::errs() << "bad node ID '" << id << "'\n";
+                }
+            }
+            auto pairs = andersen.aliasPairs(pointers);
+            for (auto &pair : pairs)
+                SVF::SVFUtil::outs() << "alias " << pair.first << " " << pair.second << "\n";
+            SVF::SVFUtil::outs() << pairs.size() << " alias pairs\n";
+        }
+        profile.stop();
+    }
+
+    if (CheckIncremental() && !LoadSnapshot().empty())
+    {
+        // the graph now holds every derived edge and field object, so a fresh solver only recomputes the sets
+        Andersen scratch(consg, policy);
+        scratch.setFieldLimits(CollapsePWC(), MaxFields());
+        scratch.mergePointerEquivalents();
+        scratch.runPointerAnalysis();
+        if (!andersen.samePointsTo(scratch))
+        {
+            SVF::SVFUtil::errs() << "incremental and from-scratch points-to sets differ\n";
+            return 1;
+        }
+        SVF::SVFUtil::outs() << "incremental and from-scratch points-to sets match\n";
+    }
+
+    if (PrintStats())
+        andersen.printStats();
+    if (!reportFile.empty())
+        andersen.dumpReport(reportFile, profile);
+    return 0;
+}
+
+
+
+
+/**
+ * Analyze each bitcode file listed in manifest (one path per line; blank lines and lines starting with '#' are
+ * skipped) in a forked worker process. The SVF singletons (LLVMModuleSet, PAG) hold one program per process, so
+ * each module gets a fresh process, and up to jobs modules are loaded and solved at the same time; the parent
+ * never loads a module, so forking stays cheap and memory is bounded by jobs programs.
+ */
+static int runBatch(const std::string &manifest, unsigned jobs, WorkListPolicy policy)
+{
+    std::ifstream inFile(manifest);
+    if (!inFile)
+    {
+        SVF::SVFUtil::errs() << "error opening " << manifest << "!!\n";
+        return 1;
+    }
+    std::vector<std::string> modules;
+    std::string line;
+    while (std::getline(inFile, line))
+    {
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty() && line[0] != '#')
+            modules.push_back(line);
+    }
+
+    std::unordered_map<pid_t, size_t> running;  ///< worker -> index of its module
+    std::vector<size_t> failed;
+    auto reap = [&]() {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+            return;
+        auto index = running[pid];
+        running.erase(pid);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed.push_back(index);
+    };
+
+    for (size_t i = 0; i < modules.size(); ++i)
+    {
+        while (running.size() >= jobs)
+            reap();
+
+        // flush before forking, so that buffered output is not written twice
+        std::cout.flush();
+        SVF::SVFUtil::outs().flush();
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            SVF::SVFUtil::errs() << "cannot fork a worker for " << modules[i] << "\n";
+            failed.push_back(i);
+            continue;
+        }
+        if (pid == 0)
+        {
+            // a report per module: <report file>.<index of the module in the manifest>
+            std::string reportFile = ReportFile().empty() ? "" : ReportFile() + "." + std::to_string(i);
+            int ret = analyzeModule({modules[i]}, policy, reportFile);
+            std::cout.flush();
+            SVF::SVFUtil::outs().flush();
+            _exit(ret);
+        }
+        running[pid] = i;
+    }
+    while (!running.empty())
+        reap();
+
+    std::sort(failed.begin(), failed.end());
+    for (auto index : failed)
+        SVF::SVFUtil::errs() << "analysis of " << modules[index] << " failed\n";
+    SVF::SVFUtil::outs() << "analyzed " << modules.size() - failed.size() << " of " << modules.size()
+                         << " modules\n";
+    return failed.empty() ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+    auto moduleNameVec =
+            OptionBase::parseOptions(argc, argv, "Whole Program Points-to Analysis",
+                                     "[options] <input-bitcode...>");
+
+    WorkListPolicy policy;
+    if (!NodeWorkList::parsePolicy(WorkListOrder(), policy))
+    {
+        SVF::SVFUtil::errs() << "unknown worklist policy '" << WorkListOrder()
+                             << "', expected fifo, lifo, lrf, topo or wave\n";
+        return 1;
+    }
+    if (Engine() != "andersen" && Engine() != "steens" && Engine() != "steens-andersen")
+    {
+        SVF::SVFUtil::errs() << "unknown engine '" << Engine() << "', expected andersen, steens or steens-andersen\n";
+        return 1;
+    }
+    if (Engine() != "andersen" && (!LoadSnapshot().empty() || !DemandQueries().empty()))
+    {
+        SVF::SVFUtil::errs() << "-andersen-engine=" << Engine() << " cannot be combined with -andersen-load or "
+                                "-andersen-demand\n";
+        return 1;
+    }
+    size_t budget;
+    if (!parseBudget(MemoryBudget(), budget))
+    {
+        SVF::SVFUtil::errs() << "bad memory budget '" << MemoryBudget() << "', expected a number of bytes with a "
+                                "K, M or G suffix, or of MB without one\n";
+        return 1;
+    }
+    if (!selectBitKernels(SimdKernels()))
+    {
+        SVF::SVFUtil::errs() << "set kernels '" << SimdKernels() << "' are unknown or not supported by this CPU, "
+                                "expected auto, scalar, avx2 or avx512\n";
+        return 1;
+    }
+
+    if (!BatchManifest().empty())
+    {
+        if (!LoadSnapshot().empty() || !SaveSnapshot().empty() || !DemandQueries().empty())
+        {
+            SVF::SVFUtil::errs() << "-andersen-batch cannot be combined with -andersen-load, -andersen-save "
+                                    "or -andersen-demand\n";
+            return 1;
+        }
+        return runBatch(BatchManifest(), std::max(BatchJobs(), 1u), policy);
+    }
+
+    return analyzeModule(moduleNameVec, policy, ReportFile());
 }
 
 
 void Andersen::runPointerAnalysis()
 {
-    // TODO: complete this method. Point-to set and worklist are defined in A5Header.h
-    //  The implementation of constraint graph is provided in the SVF library
-    WorkList<unsigned> workList;
+    NodeWorkList workList(policy);
+    indexConstraints();
+    seedAddrEdges(workList);
+    solve(workList);
+}
+
+
+void Andersen::indexConstraints()
+{
+    // make room for all existing nodes, so that the set arrays do not move while solving
+    unsigned maxId = 0;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+        maxId = std::max(maxId, (unsigned) it->first);
+    pts.reserve(maxId + 1);
+    deltaPts.reserve(maxId + 1);
+    firstFieldObj = maxId + 1;
 
     for (auto it = consg->begin(); it != consg->end(); it++)
     {
-        auto p = it->first;
-        SVF::ConstraintNode *node = it->second;
+        for (auto edge : it->second->getCopyOutEdges())
+            copyEdgeIndex.insert(edgeKey(edge->getSrcID(), edge->getDstID()));
+    }
 
-        for (auto edge : node->getAddrInEdges())
+    // from here on the solver walks the flat arrays instead of the edge sets of the graph
+    csr.build(consg);
+}
+
+
+void Andersen::seedAddrEdges(NodeWorkList &workList)
+{
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        for (auto edge : it->second->getAddrInEdges())
         {
             SVF::AddrCGEdge *addrEdge = SVF::SVFUtil::dyn_cast<SVF::AddrCGEdge>(edge);
             auto srcId = addrEdge->getSrcID();
             auto dstId = addrEdge->getDstID();
 
-            pts[dstId].insert(srcId);
-            workList.push(dstId);
+            PointsTo obj;
+            obj.insert(srcId);
+            if (addPts(getRep(dstId), obj))
+                workList.push(getRep(dstId));
         }
     }
+}
+
+
+void Andersen::solve(NodeWorkList &workList)
+{
+    // the topological order of the copy graph, used by the priority policies
+    if (policy == WorkListPolicy::TOPO || policy == WorkListPolicy::WAVE)
+        rankNodes(workList);
+
+    if (steens)
+        stats.components = steens->getNumComponents();
+    runSolver(workList);
+
+    stats.workListPops += workList.getPops();
+    collectReportedNodes();
+}
 
+
+void Andersen::runSolver(NodeWorkList &workList)
+{
+    if (pool)
+        solveParallel(workList);
+    else if (policy == WorkListPolicy::WAVE)
+        solveWaves(workList);
+    else
+        solveWorkList(workList);
+}
+
+
+void Andersen::solveWorkList(NodeWorkList &workList)
+{
     while (!workList.empty())
     {
+        solverCheckpoint();
         auto p = workList.pop();
-        SVF::ConstraintNode *pNode = consg->getConstraintNode(p);
+        // p has been merged into a cycle since it was pushed; its representative is in the worklist
+        if (getRep(p) != p)
+            continue;
+
+        // only the objects added since p was last processed need to be propagated
+        PointsTo delta;
+        delta.swap(deltaPts[p]);
+
+        processComplexConstraints(p, delta, workList);
+
+        // copy edges whose ends have equal sets after propagation, candidates for cycle detection
+        std::vector<unsigned> cycleCandidates;
+        processSimpleConstraints(p, delta, workList, &cycleCandidates);
+
+        // lazy cycle detection: equal sets across a copy edge hint that the edge is on a cycle
+        for (auto x : cycleCandidates)
+        {
+            for (auto rep : collapseCycles({x}))
+                workList.push(rep);
+        }
+
+        if (!pendingCollapses.empty())
+        {
+            for (auto rep : mergeCollapsedFields())
+                workList.push(rep);
+        }
+    }
+}
 
-        // for each o ∈ pts(p)
-        for (auto o : pts[p])
+
+void Andersen::solveWaves(NodeWorkList &workList)
+{
+    while (!workList.empty())
+    {
+        csr.compact();
+        // phase 1: propagate along copy and gep edges in topological order, remembering what each node gained
+        std::unordered_map<unsigned, PointsTo> waveDelta;
+        while (!workList.empty())
+        {
+            solverCheckpoint();
+            auto p = workList.pop();
+            if (getRep(p) != p)
+                continue;
+
+            PointsTo delta;
+            delta.swap(deltaPts[p]);
+            processSimpleConstraints(p, delta, workList, nullptr);
+            waveDelta[p].unionWith(delta);
+        }
+
+        // phase 2: resolve store and load constraints for the objects that arrived in this wave; the new
+        // copy edges push their targets for the next wave
+        for (auto &it : waveDelta)
+        {
+            auto p = getRep(it.first);
+            processComplexConstraints(p, it.second, workList);
+        }
+
+        if (!pendingCollapses.empty())
+        {
+            for (auto rep : mergeCollapsedFields())
+                workList.push(rep);
+        }
+
+        // collapse the cycles closed by the new edges and re-rank before the next wave
+        if (!workList.empty())
+            rankNodes(workList);
+    }
+}
+
+
+void Andersen::processComplexConstraints(unsigned p, const PointsTo &delta, NodeWorkList &workList)
+{
+    forEachMember(p, [&](unsigned n) {
+        // for each o ∈ Δpts(p)
+        for (auto o : delta)
         {
             // for each q --Store--> p
-            for (auto edge : pNode->getStoreInEdges())
-            {
-                SVF::StoreCGEdge *storeEdge = SVF::SVFUtil::dyn_cast<SVF::StoreCGEdge>(edge);
-                auto q = storeEdge->getSrcID();
+            csr.forEachStoreSource(n, [&](unsigned q) {
+                // in demand-driven mode, the edge is added once the content of o is needed
+                if (demandDriven && !isActive(o))
+                {
+                    pendingStores[o].push_back(q);
+                    return;
+                }
 
                 // q --Copy--> o exist?
-                bool exist = false;
-                SVF::ConstraintNode *qNode = consg->getConstraintNode(q);
-                for (auto copyEdge : qNode->getCopyOutEdges())
+                if (!copyEdgeIndex.insert(edgeKey(q, o)).second)
                 {
-                    if (copyEdge->getDstID() == o)
+                    stats.duplicateCopyEdges++;
+                }
+                else
+                {
+                    visitedNodes.insert(q);
+                    derivedEdges.emplace_back(q, o);
+                    stats.derivedCopyEdges++;
+                    if (isPruned(q))
                     {
-                        exist = true;
-                        break;
+                        // pts(q) stays empty, so the edge would never carry anything
+                        reportedNodes.insert(o);
+                        return;
                     }
-                }
 
-                if (!exist)
-                {
-                    consg->addCopyCGEdge(q, o);
-                    workList.push(q);
+                    // a new edge has not seen any of pts(q) yet
+                    if (demandDriven)
+                        activate(q, workList);
+                    addCopyEdge(q, o);
+                    if (propagate(getRep(q), getRep(o)))
+                        workList.push(getRep(o));
                 }
-            }
+            });
 
             // for each p --Load--> r
-            for (auto edge : pNode->getLoadOutEdges())
-            {
-                SVF::LoadCGEdge *loadEdge = SVF::SVFUtil::dyn_cast<SVF::LoadCGEdge>(edge);
-                auto r = loadEdge->getDstID();
+            csr.forEachLoadTarget(n, [&](unsigned r) {
+                if (demandDriven && !isActive(r))
+                    return;
 
                 // o --Copy--> r exist?
-                bool exist = false;
-                SVF::ConstraintNode *rNode = consg->getConstraintNode(r);
-                for (auto copyEdge : rNode->getCopyInEdges())
+                if (!copyEdgeIndex.insert(edgeKey(o, r)).second)
                 {
-                    if (copyEdge->getSrcID() == o)
-                    {
-                        exist = true;
-                        break;
-                    }
+                    stats.duplicateCopyEdges++;
                 }
-
-                if (!exist)
+                else
                 {
-                    consg->addCopyCGEdge(o, r);
-                    workList.push(o);
+                    visitedNodes.insert(o);
+                    derivedEdges.emplace_back(o, r);
+                    stats.derivedCopyEdges++;
+                    if (demandDriven)
+                        activate(o, workList);
+                    addCopyEdge(o, r);
+                    if (propagate(getRep(o), getRep(r)))
+                        workList.push(getRep(r));
                 }
-            }
+            });
         }
+    });
+}
 
-        // for each p --Copy--> x
-        for (auto edge : pNode->getCopyOutEdges())
-        {
-            SVF::CopyCGEdge *copyEdge = SVF::SVFUtil::dyn_cast<SVF::CopyCGEdge>(edge);
-            auto x = copyEdge->getDstID();
 
-            auto oldSize = pts[x].size();
-            pts[x].insert(pts[p].begin(), pts[p].end());
+void Andersen::processSimpleConstraints(unsigned p, const PointsTo &delta, NodeWorkList &workList,
+                                        std::vector<unsigned> *cycleCandidates)
+{
+    // interned once, so that propagating it along each copy edge is a memoized union
+    unsigned deltaId = pts.getTable().intern(delta);
+
+    forEachMember(p, [&](unsigned n) {
+        // for each p --Copy--> x
+        csr.forEachCopyTarget(n, [&](unsigned dst) {
+            auto x = getRep(dst);
+            if (x == p || (demandDriven && !isActive(dst)))
+                return;
 
             // pts(x) changed?
-            if (pts[x].size() != oldSize)
+            if (addPts(x, deltaId))
             {
                 workList.push(x);
             }
-        }
+            else if (cycleCandidates && pts.getId(x) != PointsToTable::EMPTY_SET &&
+                     pts.getId(x) == pts.getId(p) && checkedEdges.insert({n, dst}).second)
+            {
+                cycleCandidates->push_back(x);
+            }
+        });
 
         // for each p --Gep.fld--> x
-        for (auto edge : pNode->getGepOutEdges())
-        {
-            SVF::GepCGEdge *gepEdge = SVF::SVFUtil::dyn_cast<SVF::GepCGEdge>(edge);
-            auto x = gepEdge->getDstID();
+        csr.forEachGep(n, [&](unsigned gepId, unsigned dst) {
+            auto x = getRep(dst);
+            if (demandDriven && !isActive(dst))
+                return;
 
-            auto oldSize = pts[x].size();
-            for (auto o : pts[p])
+            const SVF::GepCGEdge *gepEdge = csr.getGepEdge(gepId);
+            SVF::APOffset offset = csr.getGepOffset(gepId);
+            PointsTo fieldObjs;
+            for (auto o : delta)
             {
-                auto fieldObj = consg->getGepObjVar(o, gepEdge);
-                pts[x].insert(fieldObj);
+                fieldObjs.insert(getFieldObj(o, gepEdge, offset));
             }
 
             // pts(x) changed?
-            if (pts[x].size() != oldSize)
+            if (addPts(x, fieldObjs))
             {
                 workList.push(x);
             }
-        }
+        });
+    });
+}
+
+
+void Andersen::rankNodes(NodeWorkList &workList)
+{
+    std::vector<unsigned> roots;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        if (getRep(it->first) == it->first)
+            roots.push_back(it->first);
+    }
+
+    std::vector<unsigned> topoOrder;
+    for (auto rep : collapseCycles(roots, &topoOrder))
+        workList.push(rep);
+    for (unsigned rank = 0; rank < topoOrder.size(); ++rank)
+        workList.setPriority(topoOrder[rank], rank);
+}
+
+
+void Andersen::collectReportedNodes()
+{
+    // The plain algorithm pushes every node whose set changes (i.e. is non-empty) plus the store sources and
+    // load objects that gained a new copy edge, and creates a (possibly empty) set for every copy/gep target
+    // of a popped node. Report exactly those nodes, so that the output does not depend on solver internals.
+    PointsTo sources = visitedNodes;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        if (!pts.at(getRep(it->first)).empty())
+            sources.insert(it->first);
+    }
+
+    reportedNodes.unionWith(sources);
+    for (auto n : sources)
+    {
+        SVF::ConstraintNode *node = consg->getConstraintNode(n);
+        for (auto edge : node->getCopyOutEdges())
+            reportedNodes.insert(edge->getDstID());
+        for (auto edge : node->getGepOutEdges())
+            reportedNodes.insert(edge->getDstID());
     }
 }
 
 
-/*
-void Andersen::runPointerAnalysis()
+bool Andersen::addPts(unsigned id, unsigned objsId)
 {
-    WorkList<SVF::ConstraintEdge*> worklist;
-    
-    // Initialize worklist with all edges in constraint graph
-    for (auto nodeIt = consg->begin(); nodeIt != consg->end(); ++nodeIt) {
-        auto node = nodeIt->second;
-        // Add all outgoing edges from this node
-        for (auto edgeIt = node->OutEdgeBegin(); edgeIt != node->OutEdgeEnd(); ++edgeIt) {
-            worklist.push(*edgeIt);
+    PointsToTable &table = pts.getTable();
+    unsigned oldId = pts.getId(id);
+    // the set of id is a subset of its Steensgaard set: with one object there, a non-empty set is final
+    if (steens && oldId != PointsToTable::EMPTY_SET && steens->getSingleTarget(id) != Steensgaard::NO_NODE)
+    {
+        stats.finalNodeUnions.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    unsigned newId = table.unionOf(oldId, objsId);
+    stats.unions.fetch_add(1, std::memory_order_relaxed);
+    if (newId == oldId)
+        return false;
+    stats.changedUnions.fetch_add(1, std::memory_order_relaxed);
+
+    PointsTo added;
+    added.intersectWithComplement(table.get(newId), table.get(oldId));
+    pts.setId(id, newId);
+    deltaPts[id].unionWith(added);
+    return true;
+}
+
+
+void Andersen::checkpoint()
+{
+    PointsToTable &table = pts.getTable();
+    // measuring walks all nodes; a checkpoint comes at most 64 pops apart, so this spreads it over at least
+    // 16 pops per node
+    if (table.getBudget() && checkpointsUntilMeasure-- == 0)
+    {
+        checkpointsUntilMeasure = std::max(16u, deltaPts.size() / 1024);
+        solverBytes = pts.memoryBytes() + deltaPts.memoryBytes() + csr.memoryBytes() +
+                      hashTableBytes(copyEdgeIndex) + derivedEdges.capacity() * sizeof(derivedEdges[0]) +
+                      repMap.capacity() * sizeof(unsigned) +
+                      checkedEdges.size() * (sizeof(std::pair<unsigned, unsigned>) + 4 * sizeof(void *));
+        if (solverBytes > table.getBudget() && !overBudgetReported)
+        {
+            // spilling sets cannot help then; the run goes on at the smallest footprint it can reach
+            SVF::SVFUtil::errs() << "warning: the solver structures besides the points-to sets take " << solverBytes
+                                 << " bytes, more than the memory budget of " << table.getBudget() << "\n";
+            overBudgetReported = true;
         }
     }
+    // cached alias answers are keyed by set IDs, which freed sets give away
+    if (pts.collect())
+        aliasCache.clear();
+    table.checkpoint(solverBytes);
+}
 
-    // Process constraints until fixed point
-    while (!worklist.empty()) {
-        auto edge = worklist.pop();
-        auto src = edge->getSrcID();
-        auto dst = edge->getDstID();
-
-        switch (edge->getEdgeKind()) {
-            case SVF::ConstraintEdge::Addr: {  // dst = &src
-                auto& dstSet = pts[dst];
-                if (dstSet.insert(src).second) {
-                    // If points-to set changed, add outgoing edges of dst to worklist
-                    auto dstNode = consg->getGNode(dst);
-                    for (auto it = dstNode->OutEdgeBegin(); it != dstNode->OutEdgeEnd(); ++it) {
-                        worklist.push(*it);
-                    }
-                }
-                break;
-            }
-            case SVF::ConstraintEdge::Copy: {  // dst = src
-                bool changed = false;
-                auto& srcSet = pts[src];
-                auto& dstSet = pts[dst];
-                for (auto pointee : srcSet) {
-                    if (dstSet.insert(pointee).second) {
-                        changed = true;
-                    }
-                }
-                if (changed) {
-                    auto dstNode = consg->getGNode(dst);
-                    for (auto it = dstNode->OutEdgeBegin(); it != dstNode->OutEdgeEnd(); ++it) {
-                        worklist.push(*it);
-                    }
-                }
-                break;
-            }
-            case SVF::ConstraintEdge::Load: {  // dst = *src
-                auto& srcPointees = pts[src];
-                bool changed = false;
-                for (auto pointee : srcPointees) {
-                    auto& pointeeSet = pts[pointee];
-                    auto& dstSet = pts[dst];
-                    for (auto val : pointeeSet) {
-                        if (dstSet.insert(val).second) {
-                            changed = true;
-                        }
-                    }
-                }
-                if (changed) {
-                    auto dstNode = consg->getGNode(dst);
-                    for (auto it = dstNode->OutEdgeBegin(); it != dstNode->OutEdgeEnd(); ++it) {
-                        worklist.push(*it);
-                    }
-                }
-                break;
+
+void Andersen::solverCheckpoint()
+{
+    // compacting pays off once a batch of copy edges was derived; sets also grow by unions alone, so the table
+    // is looked at after a number of pops too, more often under a memory budget
+    unsigned maxPops = pts.getTable().getBudget() ? 64 : 1024;
+    if (stats.derivedCopyEdges - derivedAtCheckpoint < 256 && ++popsSinceCheckpoint < maxPops)
+        return;
+    derivedAtCheckpoint = stats.derivedCopyEdges;
+    popsSinceCheckpoint = 0;
+    csr.compact();
+    checkpoint();
+}
+
+
+void Andersen::addCopyEdge(unsigned src, unsigned dst)
+{
+    if (consg->addCopyCGEdge(src, dst))
+        csr.addCopyEdge(src, dst);
+}
+
+
+bool Andersen::propagate(unsigned src, unsigned dst)
+{
+    if (src == dst)
+        return false;
+
+    return addPts(dst, pts.getId(src));
+}
+
+
+unsigned Andersen::getRep(unsigned id)
+{
+    if (id >= repMap.size() || repMap[id] == id)
+        return id;
+    return repMap[id] = getRep(repMap[id]);
+}
+
+
+void Andersen::mergeNode(unsigned rep, unsigned n)
+{
+    if (repMap.size() <= std::max(rep, n))
+    {
+        auto oldSize = repMap.size();
+        repMap.resize(std::max(rep, n) + 1);
+        for (auto i = oldSize; i < repMap.size(); ++i)
+            repMap[i] = i;
+    }
+    repMap[n] = rep;
+
+    // the representative owns the shared set
+    pts.setId(rep, pts.getTable().unionOf(pts.getId(rep), pts.getId(n)));
+    pts.setId(n, PointsToTable::EMPTY_SET);
+
+    // the edges of n have only seen pts(n), and those of rep only the old pts(rep): propagate everything again
+    deltaPts.reserve(std::max(rep, n) + 1);
+    deltaPts[n].clear();
+    deltaPts[rep] = pts.at(rep);
+
+    auto &repSubs = subNodes[rep];
+    repSubs.push_back(n);
+    auto subIt = subNodes.find(n);
+    if (subIt != subNodes.end())
+    {
+        repSubs.insert(repSubs.end(), subIt->second.begin(), subIt->second.end());
+        subNodes.erase(subIt);
+    }
+}
+
+
+std::vector<unsigned> Andersen::collapseCycles(const std::vector<unsigned> &roots, std::vector<unsigned> *topoOrder)
+{
+    // iterative Tarjan over the copy edges between representatives, starting from the roots
+    struct Frame
+    {
+        unsigned node;
+        std::vector<unsigned> succs;
+        size_t next;
+    };
+
+    std::unordered_map<unsigned, unsigned> index;
+    std::unordered_map<unsigned, unsigned> lowLink;
+    std::unordered_set<unsigned> onStack;
+    std::vector<unsigned> sccStack;
+    std::vector<Frame> callStack;
+    std::vector<unsigned> reps;
+    unsigned counter = 0;
+
+    auto visit = [&](unsigned n) {
+        index[n] = lowLink[n] = counter++;
+        sccStack.push_back(n);
+        onStack.insert(n);
+
+        Frame frame{n, {}, 0};
+        forEachMember(n, [&](unsigned m) {
+            csr.forEachCopyTarget(m, [&](unsigned dst) {
+                auto succ = getRep(dst);
+                if (succ != n)
+                    frame.succs.push_back(succ);
+            });
+        });
+        callStack.push_back(std::move(frame));
+    };
+
+    for (auto root : roots)
+    {
+        if (index.count(getRep(root)))
+            continue;
+
+        visit(getRep(root));
+        while (!callStack.empty())
+        {
+            Frame &frame = callStack.back();
+            if (frame.next < frame.succs.size())
+            {
+                auto succ = frame.succs[frame.next++];
+                if (!index.count(succ))
+                    visit(succ);
+                else if (onStack.count(succ))
+                    lowLink[frame.node] = std::min(lowLink[frame.node], index[succ]);
+                continue;
             }
-            case SVF::ConstraintEdge::NormalGep:
-            case SVF::ConstraintEdge::VariantGep: { // dst = gep src  (treat as copy for field-insensitive handling)
-                bool changed = false;
-                auto& srcSet = pts[src];
-                auto& dstSet = pts[dst];
-                for (auto pointee : srcSet) {
-                    if (dstSet.insert(pointee).second) {
-                        changed = true;
-                    }
-                }
-                if (changed) {
-                    auto dstNode = consg->getGNode(dst);
-                    for (auto it = dstNode->OutEdgeBegin(); it != dstNode->OutEdgeEnd(); ++it) {
-                        worklist.push(*it);
-                    }
-                }
-                break;
+
+            auto n = frame.node;
+            callStack.pop_back();
+            if (!callStack.empty())
+            {
+                auto parent = callStack.back().node;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[n]);
             }
-            case SVF::ConstraintEdge::Store: {  // *dst = src
-                auto& dstPointees = pts[dst];
-                auto& srcSet = pts[src];
-                bool changed = false;
-                for (auto pointee : dstPointees) {
-                    auto& pointeeSet = pts[pointee];
-                    for (auto val : srcSet) {
-                        if (pointeeSet.insert(val).second) {
-                            changed = true;
-                            auto pointeeNode = consg->getGNode(pointee);
-                            for (auto it = pointeeNode->OutEdgeBegin(); it != pointeeNode->OutEdgeEnd(); ++it) {
-                                worklist.push(*it);
-                            }
-                        }
-                    }
+
+            if (lowLink[n] == index[n])
+            {
+                // n is the root of an SCC; merge all other members into it
+                bool collapsed = false;
+                while (true)
+                {
+                    auto m = sccStack.back();
+                    sccStack.pop_back();
+                    onStack.erase(m);
+                    if (m == n)
+                        break;
+                    mergeNode(n, m);
+                    collapsed = true;
                 }
-                break;
+                if (collapsed)
+                    reps.push_back(n);
+                if (topoOrder)
+                    topoOrder->push_back(n);
             }
-            default:
-                break;
         }
     }
+
+    // Tarjan finishes SCCs in reverse topological order
+    if (topoOrder)
+        std::reverse(topoOrder->begin(), topoOrder->end());
+    return reps;
 }
-    */
\ No newline at end of file
+
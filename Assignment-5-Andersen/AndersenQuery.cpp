@@ -0,0 +1,91 @@
+/**
+ * AndersenQuery.cpp
+ * @author kisslune
+ */
+
+#include "ResultStore.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+/*
+ * Query tool for the binary result files written by `andersen -andersen-binary`:
+ *   andersen-query <file.res.bin> pts <node>...         objects that each node points to
+ *   andersen-query <file.res.bin> pointed-by <obj>...   nodes that point to each object
+ *   andersen-query <file.res.bin> dump                  the whole result in the text format
+ *   andersen-query <file.res.bin> info                  sizes of the file
+ * The time of each pts/pointed-by lookup is printed to stderr.
+ */
+
+static int usage()
+{
+    std::cerr << "usage: andersen-query <file.res.bin> (pts <node>... | pointed-by <obj>... | dump | info)\n";
+    return 1;
+}
+
+static void printSet(const std::vector<unsigned> &ids)
+{
+    std::cout << "{";
+    for (auto id : ids)
+        std::cout << id << ", ";
+    std::cout << "}\n";
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+        return usage();
+
+    ResultStore store;
+    if (!store.open(argv[1]))
+        return 1;
+
+    std::string command = argv[2];
+    const ResultStoreHeader &header = store.getHeader();
+    if (command == "dump")
+    {
+        for (unsigned node = 0; node < header.numNodes; ++node)
+        {
+            if (!store.isReported(node))
+                continue;
+            std::cout << node << " points to: ";
+            printSet(store.pointsTo(node));
+        }
+        return 0;
+    }
+    if (command == "info")
+    {
+        std::cout << "nodes\t" << header.numNodes << "\n"
+                  << "distinct sets\t" << header.numSets << "\n"
+                  << "objects\t" << header.numObjs << "\n"
+                  << "varint\t" << ((header.flags & ResultStore::FLAG_VARINT) ? "yes" : "no") << "\n"
+                  << "bytes\t" << header.fileSize << "\n";
+        return 0;
+    }
+    if (command != "pts" && command != "pointed-by")
+        return usage();
+
+    for (int i = 3; i < argc; ++i)
+    {
+        char *end;
+        unsigned long id = std::strtoul(argv[i], &end, 10);
+        if (*end != '\0')
+            return usage();
+
+        auto start = std::chrono::steady_clock::now();
+        bool reported = command == "pointed-by" || store.isReported(id);
+        auto ids = command == "pts" ? store.pointsTo(id) : store.pointedBy(id);
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+
+        if (!reported)
+        {
+            std::cout << id << " is not in the result\n";
+            continue;
+        }
+        std::cout << id << (command == "pts" ? " points to: " : " is pointed to by: ");
+        printSet(ids);
+        std::cerr << "(" << elapsed.count() << " us)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * BitKernels.cpp
+ * @author kisslune
+ */
+
+#include "BitKernels.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define A5_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using Word = BitKernels::Word;
+
+namespace
+{
+
+bool unionWordsScalar(Word *dst, const Word *src, size_t n)
+{
+    Word added = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        added |= src[i] & ~dst[i];
+        dst[i] |= src[i];
+    }
+    return added != 0;
+}
+
+bool intersectsWordsScalar(const Word *a, const Word *b, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (a[i] & b[i])
+            return true;
+    }
+    return false;
+}
+
+size_t popcountWordsScalar(const Word *w, size_t n)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+        count += __builtin_popcountll(w[i]);
+    return count;
+}
+
+const BitKernels scalarKernels = {"scalar", unionWordsScalar, intersectsWordsScalar, popcountWordsScalar};
+
+#ifdef A5_X86_KERNELS
+
+/// 4 words per step; the bits dst lacks are or-ed into one accumulator, tested once at the end
+__attribute__((target("avx2")))
+bool unionWordsAvx2(Word *dst, const Word *src, size_t n)
+{
+    __m256i added = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i));
+        __m256i s = _mm256_loadu_si256((const __m256i *) (src + i));
+        added = _mm256_or_si256(added, _mm256_andnot_si256(d, s));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_or_si256(d, s));
+    }
+    bool changed = !_mm256_testz_si256(added, added);
+    return unionWordsScalar(dst + i, src + i, n - i) || changed;
+}
+
+__attribute__((target("avx2")))
+bool intersectsWordsAvx2(const Word *a, const Word *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *) (b + i));
+        if (!_mm256_testz_si256(va, vb))
+            return true;
+    }
+    return intersectsWordsScalar(a + i, b + i, n - i);
+}
+
+/// Nibble lookup with vpshufb, summed per 64-bit lane with vpsadbw (Mula et al.)
+__attribute__((target("avx2,popcnt")))
+size_t popcountWordsAvx2(const Word *w, size_t n)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (w + i));
+        __m256i lo = _mm256_and_si256(v, lowNibbles);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibbles);
+        __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+    size_t count = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                   _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+    for (; i < n; ++i)
+        count += _mm_popcnt_u64(w[i]);
+    return count;
+}
+
+__attribute__((target("avx512f")))
+bool unionWordsAvx512(Word *dst, const Word *src, size_t n)
+{
+    __m512i added = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512i d = _mm512_loadu_si512(dst + i);
+        __m512i s = _mm512_loadu_si512(src + i);
+        added = _mm512_or_si512(added, _mm512_andnot_si512(d, s));
+        _mm512_storeu_si512(dst + i, _mm512_or_si512(d, s));
+    }
+    bool changed = _mm512_test_epi64_mask(added, added) != 0;
+    return unionWordsAvx2(dst + i, src + i, n - i) || changed;
+}
+
+__attribute__((target("avx512f")))
+bool intersectsWordsAvx512(const Word *a, const Word *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m512i va = _mm512_loadu_si512(a + i);
+        __m512i vb = _mm512_loadu_si512(b + i);
+        if (_mm512_test_epi64_mask(va, vb))
+            return true;
+    }
+    return intersectsWordsAvx2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+size_t popcountWordsAvx512(const Word *w, size_t n)
+{
+    __m512i total = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512(w + i)));
+    size_t count = _mm512_reduce_add_epi64(total);
+    for (; i < n; ++i)
+        count += _mm_popcnt_u64(w[i]);
+    return count;
+}
+
+const BitKernels avx2Kernels = {"avx2", unionWordsAvx2, intersectsWordsAvx2, popcountWordsAvx2};
+/// VPOPCNTQ is a later extension than AVX-512F: without it, popcount stays on the AVX2 kernel
+const BitKernels avx512Kernels = {"avx512", unionWordsAvx512, intersectsWordsAvx512, popcountWordsAvx2};
+const BitKernels avx512PopcntKernels = {"avx512", unionWordsAvx512, intersectsWordsAvx512, popcountWordsAvx512};
+
+#endif
+
+/// The kernels of isa if the CPU supports them, nullptr otherwise
+const BitKernels *kernelsFor(const std::string &isa)
+{
+    if (isa == "scalar")
+        return &scalarKernels;
+#ifdef A5_X86_KERNELS
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    bool avx512 = avx2 && __builtin_cpu_supports("avx512f");
+    if (isa == "avx2")
+        return avx2 ? &avx2Kernels : nullptr;
+    if (isa == "avx512" || isa == "auto")
+    {
+        if (avx512)
+            return __builtin_cpu_supports("avx512vpopcntdq") ? &avx512PopcntKernels : &avx512Kernels;
+        if (isa == "auto")
+            return avx2 ? &avx2Kernels : &scalarKernels;
+    }
+    return nullptr;
+#else
+    return isa == "auto" ? &scalarKernels : nullptr;
+#endif
+}
+
+std::atomic<const BitKernels *> current{nullptr};
+
+}
+
+
+const BitKernels &bitKernels()
+{
+    const BitKernels *kernels = current.load(std::memory_order_acquire);
+    if (!kernels)
+    {
+        // racing first uses all pick the same kernels
+        kernels = kernelsFor("auto");
+        current.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+
+
+bool selectBitKernels(const std::string &isa)
+{
+    const BitKernels *kernels = kernelsFor(isa);
+    if (!kernels)
+        return false;
+    current.store(kernels, std::memory_order_release);
+    return true;
+}
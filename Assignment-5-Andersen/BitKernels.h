@@ -0,0 +1,40 @@
+/**
+ * BitKernels.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_BITKERNELS_H
+#define ANSWERS_BITKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Word-array kernels behind the set operations of PointsTo, in a scalar version and, on x86-64, AVX2 and
+ * AVX-512 versions. The widest version the CPU supports is picked on first use (CPUID), unless
+ * selectBitKernels chose one before.
+ */
+struct BitKernels
+{
+    using Word = uint64_t;
+
+    const char *isa;
+    /// dst[i] |= src[i] for i < n; returns true if a word of dst changed
+    bool (*unionWords)(Word *dst, const Word *src, size_t n);
+    /// Check whether a[i] & b[i] is non-zero for some i < n
+    bool (*intersectsWords)(const Word *a, const Word *b, size_t n);
+    /// Number of set bits in w[0 .. n)
+    size_t (*popcountWords)(const Word *w, size_t n);
+};
+
+/// The kernels in use
+const BitKernels &bitKernels();
+
+/**
+ * Use the kernels of isa ("auto", "scalar", "avx2" or "avx512") from now on
+ * @return false if isa is unknown or the CPU does not support it
+ */
+bool selectBitKernels(const std::string &isa);
+
+#endif //ANSWERS_BITKERNELS_H
@@ -0,0 +1,277 @@
+/**
+ * ConstraintCSR.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_CONSTRAINTCSR_H
+#define ANSWERS_CONSTRAINTCSR_H
+
+#include "SVF-LLVM/SVFIRBuilder.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Flat snapshot of the edges of a constraint graph that the solver walks from a popped node.
+ *
+ * Nodes are renumbered densely in the order of the graph, and each edge kind is a CSR array: the row of node
+ * n is targets[offsets[dense(n)] .. offsets[dense(n) + 1]). Rows keep the order of the edge sets of SVF
+ * (ascending destination for out-edges, ascending source for in-edges), so the solver visits edges exactly
+ * as it would through the graph. Gep rows also hold the constant offset of each edge (VARIANT_GEP for variant
+ * geps) and the edge itself, which getGepObjVar needs; an edge's position in the gep arrays is a stable ID.
+ *
+ * Copy edges added while solving are appended to a side row per node. A row is sorted when it is next walked,
+ * together with the CSR row, or by sortSideRows(); compact() merges the side rows into the CSR arrays.
+ */
+class ConstraintCSR
+{
+public:
+    static constexpr unsigned NO_NODE = UINT_MAX;
+    /// Offset recorded for variant geps, which always yield the field-insensitive object
+    static constexpr SVF::APOffset VARIANT_GEP = INT64_MIN;
+
+    /// Build the arrays from the current edges of consg
+    void build(SVF::ConstraintGraph *consg)
+    {
+        clear();
+        for (auto it = consg->begin(); it != consg->end(); it++)
+        {
+            unsigned id = it->first;
+            if (id >= denseIds.size())
+                denseIds.resize(id + 1, NO_NODE);
+            denseIds[id] = nodeIds.size();
+            nodeIds.push_back(id);
+        }
+
+        copyOffsets.push_back(0);
+        storeOffsets.push_back(0);
+        loadOffsets.push_back(0);
+        gepOffsets.push_back(0);
+        for (auto id : nodeIds)
+        {
+            SVF::ConstraintNode *node = consg->getConstraintNode(id);
+            for (auto edge : node->getCopyOutEdges())
+                copyTargets.push_back(edge->getDstID());
+            for (auto edge : node->getStoreInEdges())
+                storeSources.push_back(edge->getSrcID());
+            for (auto edge : node->getLoadOutEdges())
+                loadTargets.push_back(edge->getDstID());
+            for (auto edge : node->getGepOutEdges())
+            {
+                auto gepEdge = SVF::SVFUtil::dyn_cast<SVF::GepCGEdge>(edge);
+                auto normalGepEdge = SVF::SVFUtil::dyn_cast<SVF::NormalGepCGEdge>(edge);
+                gepTargets.push_back(edge->getDstID());
+                gepFieldOffsets.push_back(normalGepEdge ? normalGepEdge->getConstantFieldIdx() : VARIANT_GEP);
+                gepEdges.push_back(gepEdge);
+            }
+            copyOffsets.push_back(copyTargets.size());
+            storeOffsets.push_back(storeSources.size());
+            loadOffsets.push_back(loadTargets.size());
+            gepOffsets.push_back(gepTargets.size());
+        }
+        sideCopyTargets.resize(nodeIds.size());
+        sortedSideLength.resize(nodeIds.size());
+    }
+
+    /// Record a copy edge added to the graph while solving
+    void addCopyEdge(unsigned src, unsigned dst)
+    {
+        auto dense = addNode(src);
+        auto &row = sideCopyTargets[dense];
+        if (row.size() == sortedSideLength[dense] && !row.empty() && dst < row.back())
+            unsortedRows.push_back(dense);
+        else if (row.size() == sortedSideLength[dense])
+            sortedSideLength[dense]++;
+        row.push_back(dst);
+        sideCopyEdges++;
+    }
+
+    /// Sort the side rows appended to out of order, so that they can be walked from several threads
+    void sortSideRows()
+    {
+        for (auto dense : unsortedRows)
+            sortSideRow(dense);
+        unsortedRows.clear();
+    }
+
+    /// Merge the side rows into the copy CSR arrays once they hold a sizeable share of the copy edges
+    void compact()
+    {
+        if (sideCopyEdges < 1024 || sideCopyEdges * 4 < copyTargets.size())
+            return;
+        sortSideRows();
+
+        std::vector<unsigned> offsets(1, 0);
+        std::vector<unsigned> targets;
+        targets.reserve(copyTargets.size() + sideCopyEdges);
+        for (unsigned dense = 0; dense < nodeIds.size(); ++dense)
+        {
+            auto &side = sideCopyTargets[dense];
+            if (dense + 1 < copyOffsets.size())
+                std::merge(copyTargets.begin() + copyOffsets[dense], copyTargets.begin() + copyOffsets[dense + 1],
+                           side.begin(), side.end(), std::back_inserter(targets));
+            else
+                targets.insert(targets.end(), side.begin(), side.end());
+            offsets.push_back(targets.size());
+            std::vector<unsigned>().swap(side);
+            sortedSideLength[dense] = 0;
+        }
+        copyOffsets.swap(offsets);
+        copyTargets.swap(targets);
+        sideCopyEdges = 0;
+    }
+
+    /// Bytes held by the arrays
+    size_t memoryBytes() const
+    {
+        size_t bytes = (denseIds.capacity() + nodeIds.capacity() + copyOffsets.capacity() + copyTargets.capacity() +
+                        storeOffsets.capacity() + storeSources.capacity() + loadOffsets.capacity() +
+                        loadTargets.capacity() + gepOffsets.capacity() + gepTargets.capacity()) * sizeof(unsigned) +
+                       gepFieldOffsets.capacity() * sizeof(SVF::APOffset) +
+                       gepEdges.capacity() * sizeof(const SVF::GepCGEdge *) +
+                       sideCopyTargets.capacity() * sizeof(std::vector<unsigned>) +
+                       (sortedSideLength.capacity() + unsortedRows.capacity()) * sizeof(unsigned);
+        for (auto &side : sideCopyTargets)
+            bytes += side.capacity() * sizeof(unsigned);
+        return bytes;
+    }
+
+    /// Apply f to the destination of each copy out-edge of id, in ascending order
+    template<class F>
+    void forEachCopyTarget(unsigned id, F f)
+    {
+        auto dense = denseOf(id);
+        if (dense == NO_NODE)
+            return;
+        if (sortedSideLength[dense] != sideCopyTargets[dense].size())
+            sortSideRow(dense);
+        const unsigned *it = nullptr, *end = nullptr;
+        if (dense + 1 < copyOffsets.size())
+        {
+            it = copyTargets.data() + copyOffsets[dense];
+            end = copyTargets.data() + copyOffsets[dense + 1];
+        }
+        auto &side = sideCopyTargets[dense];
+        auto sideIt = side.begin();
+        while (it != end || sideIt != side.end())
+        {
+            if (sideIt == side.end() || (it != end && *it < *sideIt))
+                f(*it++);
+            else
+                f(*sideIt++);
+        }
+    }
+
+    /// Apply f to the source of each store in-edge of id
+    template<class F>
+    inline void forEachStoreSource(unsigned id, F f) const
+    { forEachInRow(id, storeOffsets, storeSources, f); }
+
+    /// Apply f to the destination of each load out-edge of id
+    template<class F>
+    inline void forEachLoadTarget(unsigned id, F f) const
+    { forEachInRow(id, loadOffsets, loadTargets, f); }
+
+    /// Apply f(gep edge ID, destination) to each gep out-edge of id
+    template<class F>
+    void forEachGep(unsigned id, F f) const
+    {
+        auto dense = denseOf(id);
+        if (dense == NO_NODE || dense + 1 >= gepOffsets.size())
+            return;
+        for (auto i = gepOffsets[dense]; i < gepOffsets[dense + 1]; ++i)
+            f(i, gepTargets[i]);
+    }
+
+    inline const SVF::GepCGEdge *getGepEdge(unsigned gepId) const
+    { return gepEdges[gepId]; }
+
+    inline SVF::APOffset getGepOffset(unsigned gepId) const
+    { return gepFieldOffsets[gepId]; }
+
+    inline unsigned getNumGepEdges() const
+    { return gepEdges.size(); }
+
+private:
+    inline unsigned denseOf(unsigned id) const
+    { return id < denseIds.size() ? denseIds[id] : NO_NODE; }
+
+    /// Dense ID of id, giving one to a node created while solving (e.g. a field object)
+    unsigned addNode(unsigned id)
+    {
+        if (id >= denseIds.size())
+            denseIds.resize(id + 1, NO_NODE);
+        if (denseIds[id] == NO_NODE)
+        {
+            denseIds[id] = nodeIds.size();
+            nodeIds.push_back(id);
+            sideCopyTargets.emplace_back();
+            sortedSideLength.push_back(0);
+        }
+        return denseIds[id];
+    }
+
+    /// Sort the appended tail of a side row and merge it with the sorted head
+    void sortSideRow(unsigned dense)
+    {
+        auto &row = sideCopyTargets[dense];
+        auto middle = row.begin() + sortedSideLength[dense];
+        std::sort(middle, row.end());
+        std::inplace_merge(row.begin(), middle, row.end());
+        sortedSideLength[dense] = row.size();
+    }
+
+    template<class F>
+    void forEachInRow(unsigned id, const std::vector<unsigned> &offsets, const std::vector<unsigned> &values,
+                      F f) const
+    {
+        auto dense = denseOf(id);
+        if (dense == NO_NODE || dense + 1 >= offsets.size())
+            return;
+        for (auto i = offsets[dense]; i < offsets[dense + 1]; ++i)
+            f(values[i]);
+    }
+
+    void clear()
+    {
+        denseIds.clear();
+        nodeIds.clear();
+        copyOffsets.clear();
+        copyTargets.clear();
+        storeOffsets.clear();
+        storeSources.clear();
+        loadOffsets.clear();
+        loadTargets.clear();
+        gepOffsets.clear();
+        gepTargets.clear();
+        gepFieldOffsets.clear();
+        gepEdges.clear();
+        sideCopyTargets.clear();
+        sortedSideLength.clear();
+        unsortedRows.clear();
+        sideCopyEdges = 0;
+    }
+
+    std::vector<unsigned> denseIds;     ///< node ID -> dense ID, NO_NODE if none
+    std::vector<unsigned> nodeIds;      ///< dense ID -> node ID
+
+    std::vector<unsigned> copyOffsets;
+    std::vector<unsigned> copyTargets;
+    std::vector<unsigned> storeOffsets;
+    std::vector<unsigned> storeSources;
+    std::vector<unsigned> loadOffsets;
+    std::vector<unsigned> loadTargets;
+    std::vector<unsigned> gepOffsets;
+    std::vector<unsigned> gepTargets;
+    std::vector<SVF::APOffset> gepFieldOffsets;
+    std::vector<const SVF::GepCGEdge *> gepEdges;
+
+    std::vector<std::vector<unsigned>> sideCopyTargets;     ///< dense ID -> copy edges added since compact()
+    std::vector<unsigned> sortedSideLength;     ///< dense ID -> length of the sorted head of its side row
+    std::vector<unsigned> unsortedRows;     ///< dense IDs of the side rows appended to out of order
+    size_t sideCopyEdges = 0;
+};
+
+#endif //ANSWERS_CONSTRAINTCSR_H
@@ -0,0 +1,160 @@
+/**
+ * DemandAndersen.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+/*
+ * Demand-driven solving.
+ *
+ * Only the active nodes are solved. A node becomes active when a query needs its set, and then so does
+ * everything its set depends on: the sources of its copy and gep in-edges, the pointer of each load into it,
+ * and, for an object, the sources stored into it. Which objects a load reads and which objects a store writes
+ * are only known from the solved sets, so the active part grows while solving:
+ *  - a load p --> r into an active r activates each object o of pts(p);
+ *  - a store q --> p into an object o of pts(p) is kept pending until o is active, and then activates q;
+ *  - an active object activates the pointer of each store that may write to it. A Steensgaard pass over the
+ *    graph tells which: those whose pointer points to the class of the object (or of its base object, for a
+ *    field object), as Steensgaard's sets hold Andersen's.
+ * Copy and gep edges into inactive nodes, and loads into them, are not followed. The sets of active nodes are
+ * therefore the same as those of the exhaustive solver.
+ */
+
+const PointsTo &Andersen::queryPointsTo(unsigned node)
+{
+    if (!demandDriven)
+    {
+        demandDriven = true;
+        indexConstraints();
+
+        storeAliases.reset(new Steensgaard(consg));
+        storeAliases->analyze();
+        for (auto it = consg->begin(); it != consg->end(); it++)
+        {
+            auto target = storeAliases->getPointeeClass(it->first);
+            if (!it->second->getStoreInEdges().empty() && target != Steensgaard::NO_NODE)
+                storePointersOf[target].push_back(it->first);
+        }
+    }
+
+    NodeWorkList workList(policy);
+    activate(node, workList);
+    solveWorkList(workList);
+    return pts.at(getRep(node));
+}
+
+
+void Andersen::activate(unsigned root, NodeWorkList &workList)
+{
+    SVF::SVFIR *pag = SVF::PAG::getPAG();
+    auto isObject = [&](unsigned n) {
+        return SVF::SVFUtil::isa<SVF::ObjVar>(pag->getGNode(n)) ||
+               !consg->getConstraintNode(n)->getAddrOutEdges().empty();
+    };
+
+    // the nodes that root depends on and that are not solved yet
+    std::vector<unsigned> stack = {root};
+    std::vector<unsigned> added;
+    while (!stack.empty())
+    {
+        auto n = stack.back();
+        stack.pop_back();
+        if (isActive(n))
+            continue;
+
+        if (n >= activeNodes.size())
+            activeNodes.resize(n + 1, false);
+        activeNodes[n] = true;
+        added.push_back(n);
+        stats.demandNodes++;
+
+        // merged nodes share one set, so the inputs of all of them are needed
+        forEachMember(getRep(n), [&](unsigned m) {
+            stack.push_back(m);
+        });
+
+        SVF::ConstraintNode *node = consg->getConstraintNode(n);
+        for (auto edge : node->getCopyInEdges())
+            stack.push_back(edge->getSrcID());
+        for (auto edge : node->getGepInEdges())
+            stack.push_back(edge->getSrcID());
+        for (auto edge : node->getLoadInEdges())
+            stack.push_back(edge->getSrcID());
+
+        auto pendingIt = pendingStores.find(n);
+        if (pendingIt != pendingStores.end())
+            stack.insert(stack.end(), pendingIt->second.begin(), pendingIt->second.end());
+
+        if (isObject(n))
+        {
+            auto base = SVF::SVFUtil::isa<SVF::ObjVar>(pag->getGNode(n)) ? consg->getBaseObjVar(n) : n;
+            auto storesIt = storePointersOf.find(storeAliases->getClass(base));
+            if (storesIt != storePointersOf.end())
+            {
+                stack.insert(stack.end(), storesIt->second.begin(), storesIt->second.end());
+                storePointersOf.erase(storesIt);
+            }
+        }
+    }
+
+    // bring the new nodes up to date with the solved nodes they depend on
+    for (auto n : added)
+    {
+        auto rep = getRep(n);
+        SVF::ConstraintNode *node = consg->getConstraintNode(n);
+
+        for (auto edge : node->getAddrInEdges())
+        {
+            PointsTo obj;
+            obj.insert(edge->getSrcID());
+            if (addPts(rep, obj))
+                workList.push(rep);
+        }
+
+        for (auto edge : node->getCopyInEdges())
+        {
+            if (propagate(getRep(edge->getSrcID()), rep))
+                workList.push(rep);
+        }
+
+        for (auto edge : node->getGepInEdges())
+        {
+            SVF::GepCGEdge *gepEdge = SVF::SVFUtil::dyn_cast<SVF::GepCGEdge>(edge);
+            PointsTo fieldObjs;
+            for (auto o : pts.at(getRep(gepEdge->getSrcID())))
+                fieldObjs.insert(getFieldObj(o, gepEdge));
+            if (addPts(rep, fieldObjs))
+                workList.push(rep);
+        }
+
+        // the loads of an active pointer into inactive nodes were skipped: resolve them again
+        for (auto edge : node->getLoadInEdges())
+        {
+            auto p = getRep(edge->getSrcID());
+            if (pts.getId(p) == PointsToTable::EMPTY_SET)
+                continue;
+            deltaPts[p].unionWith(pts.at(p));
+            workList.push(p);
+        }
+
+        auto pendingIt = pendingStores.find(n);
+        if (pendingIt != pendingStores.end())
+        {
+            for (auto q : pendingIt->second)
+            {
+                if (!copyEdgeIndex.insert(edgeKey(q, n)).second)
+                    continue;
+                visitedNodes.insert(q);
+                derivedEdges.emplace_back(q, n);
+                stats.derivedCopyEdges++;
+                if (isPruned(q))
+                    continue;
+                addCopyEdge(q, n);
+                if (propagate(getRep(q), rep))
+                    workList.push(rep);
+            }
+            pendingStores.erase(pendingIt);
+        }
+    }
+}
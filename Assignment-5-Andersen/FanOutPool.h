@@ -0,0 +1,97 @@
+/**
+ * FanOutPool.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_FANOUTPOOL_H
+#define ANSWERS_FANOUTPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads that run one job at a time: runEach(f) calls f(t) once on every thread t, the calling
+ * thread being thread 0, and returns once all calls have returned.
+ */
+class FanOutPool
+{
+public:
+    /// Start threads - 1 workers; the thread calling runEach is thread 0
+    explicit FanOutPool(unsigned threads)
+    {
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~FanOutPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    FanOutPool(const FanOutPool &) = delete;
+    FanOutPool &operator=(const FanOutPool &) = delete;
+
+    inline unsigned getThreads() const
+    { return workers.size() + 1; }
+
+    /// Call f(t) on every thread t
+    void runEach(const std::function<void(unsigned)> &f)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            job = &f;
+            working = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        f(0);
+
+        std::unique_lock<std::mutex> guard(mutex);
+        done.wait(guard, [this]() { return working == 0; });
+        job = nullptr;
+    }
+
+private:
+    void workerLoop(unsigned self)
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            const std::function<void(unsigned)> *current;
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                wake.wait(guard, [&]() { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                current = job;
+            }
+            (*current)(self);
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (--working == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;   ///< a job is posted, or the pool stops
+    std::condition_variable done;   ///< all workers are through the current job
+    const std::function<void(unsigned)> *job = nullptr;
+    unsigned working = 0;           ///< workers still in the current job
+    unsigned long generation = 0;   ///< jobs posted so far
+    bool stopping = false;
+};
+
+#endif //ANSWERS_FANOUTPOOL_H
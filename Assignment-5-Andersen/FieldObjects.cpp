@@ -0,0 +1,145 @@
+/**
+ * FieldObjects.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+namespace
+{
+
+inline FieldMemoKey fieldMemoKey(unsigned o, SVF::APOffset offset)
+{
+    bool variant = offset == ConstraintCSR::VARIANT_GEP;
+    return {o, variant, variant ? 0 : offset};
+}
+
+}
+
+/*
+ * Field objects of gep edges.
+ *
+ * SVF creates the field object (base, offset) on the first getGepObjVar call; the solver asks again for every
+ * object popped through every gep edge, so the answers are memoized by (object, offset).
+ *
+ * Pointer arithmetic in a loop (a gep with a non-zero offset on a copy/gep cycle) creates a new field object on
+ * every trip around the cycle, up to the field limit of SVF. Optionally, such objects, and objects with more
+ * field objects than a limit, are made field-insensitive instead: every gep on them yields the base object,
+ * and the field objects they already have are merged into it, so that whatever was stored into one of them is
+ * seen through all the others.
+ */
+
+unsigned Andersen::getFieldObj(unsigned o, const SVF::GepCGEdge *gepEdge)
+{
+    auto normalGepEdge = SVF::SVFUtil::dyn_cast<SVF::NormalGepCGEdge>(gepEdge);
+    return getFieldObj(o, gepEdge, normalGepEdge ? normalGepEdge->getConstantFieldIdx() : ConstraintCSR::VARIANT_GEP);
+}
+
+
+unsigned Andersen::getFieldObj(unsigned o, const SVF::GepCGEdge *gepEdge, SVF::APOffset offset)
+{
+    auto collapsedIt = collapsedObjs.find(o);
+    if (collapsedIt != collapsedObjs.end())
+        return collapsedIt->second;
+
+    if (collapsePWC && pwcGepEdges.count(std::make_tuple(gepEdge->getSrcID(), gepEdge->getDstID(), offset)))
+        return collapseObject(o);
+
+    auto key = fieldMemoKey(o, offset);
+    auto memoIt = fieldObjMemo.find(key);
+    if (memoIt != fieldObjMemo.end())
+    {
+        stats.fieldMemoHits++;
+        return memoIt->second;
+    }
+
+    // with a limit, track which objects share a base, so that a collapse finds all of them
+    bool limited = collapsePWC || maxFields > 0;
+    if (limited)
+    {
+        auto base = consg->getBaseObjVar(o);
+        if (collapsedObjs.count(base))
+            return collapseObject(o);
+        if (baseOf.emplace(o, base).second)
+            fieldsOfBase[base].push_back(o);
+    }
+
+    auto fieldObj = consg->getGepObjVar(o, gepEdge);
+    fieldObjMemo[key] = fieldObj;
+    if (fieldObj >= firstFieldObj && !loggedFieldObjs.test(fieldObj))
+    {
+        // variant geps resolve to the field-insensitive object, which exists before solving
+        loggedFieldObjs.insert(fieldObj);
+        fieldObjLog.push_back({fieldObj, o, offset == ConstraintCSR::VARIANT_GEP ? 0 : offset});
+        stats.fieldObjects++;
+    }
+
+    if (limited)
+    {
+        auto base = baseOf[o];
+        if (baseOf.emplace(fieldObj, base).second)
+        {
+            auto &fields = fieldsOfBase[base];
+            fields.push_back(fieldObj);
+            if (maxFields > 0 && fields.size() > maxFields)
+                return collapseObject(o);
+        }
+    }
+    return fieldObj;
+}
+
+
+unsigned Andersen::findFieldObj(unsigned o, const SVF::GepCGEdge *gepEdge, SVF::APOffset offset) const
+{
+    auto collapsedIt = collapsedObjs.find(o);
+    if (collapsedIt != collapsedObjs.end())
+        return collapsedIt->second;
+    if (collapsePWC && pwcGepEdges.count(std::make_tuple(gepEdge->getSrcID(), gepEdge->getDstID(), offset)))
+        return ConstraintCSR::NO_NODE;
+
+    auto memoIt = fieldObjMemo.find(fieldMemoKey(o, offset));
+    return memoIt == fieldObjMemo.end() ? ConstraintCSR::NO_NODE : memoIt->second;
+}
+
+
+unsigned Andersen::collapseObject(unsigned o)
+{
+    auto baseIt = baseOf.find(o);
+    auto base = baseIt == baseOf.end() ? consg->getBaseObjVar(o) : baseIt->second;
+    auto fiObj = consg->getFIObjVar(base);
+    if (baseOf.emplace(o, base).second)
+        fieldsOfBase[base].push_back(o);
+
+    if (!collapsedObjs.count(base))
+    {
+        stats.collapsedObjects++;
+        collapsedObjs[base] = fiObj;
+        for (auto field : fieldsOfBase[base])
+            collapsedObjs[field] = fiObj;
+    }
+    // o may be a field object first seen after its base was collapsed
+    collapsedObjs[o] = fiObj;
+    pendingCollapses.push_back(base);
+    return fiObj;
+}
+
+
+std::vector<unsigned> Andersen::mergeCollapsedFields()
+{
+    std::vector<unsigned> changed;
+    for (auto base : pendingCollapses)
+    {
+        auto fiObj = collapsedObjs[base];
+        for (auto field : fieldsOfBase[base])
+        {
+            auto rep = getRep(fiObj);
+            auto fieldRep = getRep(field);
+            if (fieldRep == rep)
+                continue;
+            mergeNode(rep, fieldRep);
+            changed.push_back(rep);
+        }
+    }
+    pendingCollapses.clear();
+    return changed;
+}
@@ -0,0 +1,427 @@
+/**
+ * IncrementalAndersen.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+#include <set>
+#include <sstream>
+#include <tuple>
+
+/*
+ * Incremental re-analysis.
+ *
+ * A snapshot holds what a later run needs to continue from the solved state instead of from empty sets:
+ *  - the constraint edges that were solved (so that the next run can tell which ones are new);
+ *  - the field objects created while solving, in creation order, to create them again;
+ *  - the copy edges derived from store/load edges;
+ *  - the points-to sets, each distinct set written once;
+ *  - the nodes visited and reported, which decide which empty sets appear in the result file.
+ * Andersen's analysis is monotone: the old sets are below the new fixpoint, so the next run only has to
+ * propagate the effect of the new constraints. That holds only if every constraint solved before is still in
+ * the program; if one was removed, the old sets may be too large and the next run solves from scratch.
+ *
+ * The file is line based:
+ *   andersen-snapshot <version>
+ *   edge <a|c|s|l> <src> <dst>
+ *   edge g <src> <dst> <field, or -1 for a variant gep>
+ *   field <id> <base> <offset>
+ *   derived <src> <dst>
+ *   visited <id>
+ *   reported <id>
+ *   set <index> <obj>...
+ *   node <id> <set index>
+ */
+
+namespace
+{
+
+constexpr unsigned SNAPSHOT_VERSION = 2;
+
+/// (src, dst, field) of a gep edge: geps of different fields may join the same two nodes
+using GepKey = std::tuple<unsigned, unsigned, SVF::s64_t>;
+
+/// Content of a snapshot file, read in full before any of it is applied
+struct Snapshot
+{
+    std::unordered_map<char, std::unordered_set<uint64_t>> edges;   ///< a, c, s or l -> keys of the solved edges
+    std::set<GepKey> gepEdges;
+    std::vector<FieldObjRecord> fields;
+    std::vector<std::pair<unsigned, unsigned>> derivedEdges;
+    std::vector<unsigned> visited;
+    std::vector<unsigned> reported;
+    std::unordered_map<unsigned, std::vector<unsigned>> sets;   ///< set index -> objects
+    std::vector<std::pair<unsigned, unsigned>> nodes;   ///< (node, set index)
+};
+
+inline uint64_t snapshotKey(unsigned src, unsigned dst)
+{ return ((uint64_t) src << 32) | dst; }
+
+inline GepKey gepKey(const SVF::ConstraintEdge *edge)
+{
+    SVF::s64_t field = -1;
+    if (auto *normalGep = SVF::SVFUtil::dyn_cast<SVF::NormalGepCGEdge>(edge))
+        field = normalGep->getConstantFieldIdx();
+    return GepKey(edge->getSrcID(), edge->getDstID(), field);
+}
+
+bool readSnapshot(const std::string &fname, Snapshot &snapshot)
+{
+    std::ifstream inFile(fname);
+    if (!inFile)
+    {
+        SVF::SVFUtil::errs() << "error opening " << fname << "!!\n";
+        return false;
+    }
+
+    std::string line, tag;
+    unsigned version = 0;
+    if (!std::getline(inFile, line) || !(std::istringstream(line) >> tag >> version) ||
+        tag != "andersen-snapshot" || version != SNAPSHOT_VERSION)
+    {
+        SVF::SVFUtil::errs() << fname << " is not an Andersen snapshot of version " << SNAPSHOT_VERSION << "\n";
+        return false;
+    }
+
+    unsigned lineNo = 1;
+    while (std::getline(inFile, line))
+    {
+        ++lineNo;
+        std::istringstream in(line);
+        bool ok = static_cast<bool>(in >> tag);
+        if (!ok)
+            continue;
+
+        if (tag == "edge")
+        {
+            char kind;
+            unsigned src, dst;
+            SVF::s64_t field;
+            ok = static_cast<bool>(in >> kind >> src >> dst);
+            if (ok && kind == 'g')
+            {
+                ok = static_cast<bool>(in >> field);
+                snapshot.gepEdges.emplace(src, dst, field);
+            }
+            else if (ok && (kind == 'a' || kind == 'c' || kind == 's' || kind == 'l'))
+            {
+                snapshot.edges[kind].insert(snapshotKey(src, dst));
+            }
+            else
+            {
+                // an edge of another kind would never be counted as removed from the program
+                ok = false;
+            }
+        }
+        else if (tag == "field")
+        {
+            FieldObjRecord record;
+            ok = static_cast<bool>(in >> record.fieldObj >> record.base >> record.offset);
+            snapshot.fields.push_back(record);
+        }
+        else if (tag == "derived")
+        {
+            unsigned src, dst;
+            ok = static_cast<bool>(in >> src >> dst);
+            snapshot.derivedEdges.emplace_back(src, dst);
+        }
+        else if (tag == "visited" || tag == "reported")
+        {
+            unsigned id;
+            ok = static_cast<bool>(in >> id);
+            (tag == "visited" ? snapshot.visited : snapshot.reported).push_back(id);
+        }
+        else if (tag == "set")
+        {
+            unsigned index, obj;
+            ok = static_cast<bool>(in >> index);
+            auto &objs = snapshot.sets[index];
+            while (in >> obj)
+                objs.push_back(obj);
+        }
+        else if (tag == "node")
+        {
+            unsigned id, index;
+            ok = static_cast<bool>(in >> id >> index) && snapshot.sets.count(index);
+            snapshot.nodes.emplace_back(id, index);
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            SVF::SVFUtil::errs() << fname << ":" << lineNo << ": malformed snapshot line\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Count the constraint edges of the snapshot that are not in the graph any more
+unsigned countRemovedEdges(SVF::ConstraintGraph *consg, const Snapshot &snapshot)
+{
+    std::unordered_map<char, std::unordered_set<uint64_t>> edges;
+    std::set<GepKey> gepEdges;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        SVF::ConstraintNode *node = it->second;
+        for (auto edge : node->getAddrOutEdges())
+            edges['a'].insert(snapshotKey(edge->getSrcID(), edge->getDstID()));
+        for (auto edge : node->getCopyOutEdges())
+            edges['c'].insert(snapshotKey(edge->getSrcID(), edge->getDstID()));
+        for (auto edge : node->getStoreOutEdges())
+            edges['s'].insert(snapshotKey(edge->getSrcID(), edge->getDstID()));
+        for (auto edge : node->getLoadOutEdges())
+            edges['l'].insert(snapshotKey(edge->getSrcID(), edge->getDstID()));
+        for (auto edge : node->getGepOutEdges())
+            gepEdges.insert(gepKey(edge));
+    }
+
+    unsigned removed = 0;
+    for (auto &it : snapshot.edges)
+    {
+        for (auto key : it.second)
+            removed += !edges[it.first].count(key);
+    }
+    for (auto &key : snapshot.gepEdges)
+        removed += !gepEdges.count(key);
+    return removed;
+}
+
+}
+
+
+bool Andersen::saveSnapshot(const std::string &fname)
+{
+    std::ofstream outFile(fname, std::ios::out);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return false;
+    }
+
+    outFile << "andersen-snapshot " << SNAPSHOT_VERSION << "\n";
+
+    // the derived edges are in the graph as well, but they are not constraints of the program
+    std::unordered_set<uint64_t> derivedKeys;
+    for (auto &edge : derivedEdges)
+        derivedKeys.insert(edgeKey(edge.first, edge.second));
+
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        SVF::ConstraintNode *node = it->second;
+        for (auto edge : node->getAddrOutEdges())
+            outFile << "edge a " << edge->getSrcID() << " " << edge->getDstID() << "\n";
+        for (auto edge : node->getCopyOutEdges())
+        {
+            if (!derivedKeys.count(edgeKey(edge->getSrcID(), edge->getDstID())))
+                outFile << "edge c " << edge->getSrcID() << " " << edge->getDstID() << "\n";
+        }
+        for (auto edge : node->getStoreOutEdges())
+            outFile << "edge s " << edge->getSrcID() << " " << edge->getDstID() << "\n";
+        for (auto edge : node->getLoadOutEdges())
+            outFile << "edge l " << edge->getSrcID() << " " << edge->getDstID() << "\n";
+        for (auto edge : node->getGepOutEdges())
+            outFile << "edge g " << edge->getSrcID() << " " << edge->getDstID() << " " << std::get<2>(gepKey(edge))
+                    << "\n";
+    }
+
+    for (auto &record : fieldObjLog)
+        outFile << "field " << record.fieldObj << " " << record.base << " " << record.offset << "\n";
+    for (auto &edge : derivedEdges)
+        outFile << "derived " << edge.first << " " << edge.second << "\n";
+    for (auto id : visitedNodes)
+        outFile << "visited " << id << "\n";
+    for (auto id : reportedNodes)
+        outFile << "reported " << id << "\n";
+
+    // interned sets have one ID per distinct set, so each set is written once
+    std::unordered_set<unsigned> writtenSets;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        unsigned setId = pts.getId(getRep(it->first));
+        if (setId == PointsToTable::EMPTY_SET)
+            continue;
+        if (writtenSets.insert(setId).second)
+        {
+            outFile << "set " << setId;
+            for (auto obj : pts.getTable().get(setId))
+                outFile << " " << obj;
+            outFile << "\n";
+        }
+        outFile << "node " << it->first << " " << setId << "\n";
+    }
+    return true;
+}
+
+
+void Andersen::runIncrementalAnalysis(const std::string &fname)
+{
+    Snapshot snapshot;
+    if (!readSnapshot(fname, snapshot))
+    {
+        SVF::SVFUtil::errs() << "solving from scratch\n";
+        runPointerAnalysis();
+        return;
+    }
+    // no derived edge is in the graph yet, so its copy edges are those of the program
+    if (unsigned removed = countRemovedEdges(consg, snapshot))
+    {
+        SVF::SVFUtil::errs() << removed << " constraints solved in " << fname
+                             << " are not in the program any more, solving from scratch\n";
+        runPointerAnalysis();
+        return;
+    }
+
+    NodeWorkList workList(policy);
+    indexConstraints();
+
+    // create the field objects again; their IDs follow the nodes of this graph, which may have grown
+    std::unordered_map<unsigned, unsigned> idMap;
+    auto mapId = [&](unsigned id) {
+        auto it = idMap.find(id);
+        return it == idMap.end() ? id : it->second;
+    };
+    for (auto &record : snapshot.fields)
+    {
+        auto base = mapId(record.base);
+        auto fieldObj = consg->getGepObjVar(base, record.offset);
+        idMap[record.fieldObj] = fieldObj;
+        if (fieldObj >= firstFieldObj && !loggedFieldObjs.test(fieldObj))
+        {
+            loggedFieldObjs.insert(fieldObj);
+            fieldObjLog.push_back({fieldObj, base, record.offset});
+        }
+        pts.reserve(fieldObj + 1);
+        deltaPts.reserve(fieldObj + 1);
+    }
+
+    // restore the sets; nodes merged in this run get the union of their old sets
+    std::unordered_map<unsigned, unsigned> setIds;
+    for (auto &it : snapshot.sets)
+    {
+        PointsTo objs;
+        for (auto obj : it.second)
+            objs.insert(mapId(obj));
+        setIds[it.first] = pts.getTable().intern(objs);
+    }
+    std::unordered_map<unsigned, unsigned> oldSets;     ///< node -> ID of its old set
+    for (auto &node : snapshot.nodes)
+    {
+        auto id = mapId(node.first);
+        auto rep = getRep(id);
+        oldSets[id] = setIds[node.second];
+        pts.setId(rep, pts.getTable().unionOf(pts.getId(rep), oldSets[id]));
+    }
+
+    for (auto &edge : snapshot.derivedEdges)
+    {
+        auto src = mapId(edge.first);
+        auto dst = mapId(edge.second);
+        if (!copyEdgeIndex.insert(edgeKey(src, dst)).second)
+            continue;
+
+        derivedEdges.emplace_back(src, dst);
+        if (isPruned(src))
+            reportedNodes.insert(dst);
+        else
+            addCopyEdge(src, dst);
+    }
+    for (auto id : snapshot.visited)
+        visitedNodes.insert(mapId(id));
+    for (auto id : snapshot.reported)
+        reportedNodes.insert(mapId(id));
+
+    // a node propagates its whole set again if one of its constraints is new, or if nodes merged into it in
+    // this run had different sets, so that the edges of some of them have not seen the union
+    auto reactivate = [&](unsigned n) {
+        auto rep = getRep(n);
+        if (pts.getId(rep) == PointsToTable::EMPTY_SET)
+            return;
+        deltaPts[rep].unionWith(pts.at(rep));
+        workList.push(rep);
+    };
+    for (auto &it : subNodes)
+    {
+        bool differ = false;
+        forEachMember(it.first, [&](unsigned n) {
+            auto oldIt = oldSets.find(n);
+            auto oldId = oldIt == oldSets.end() ? PointsToTable::EMPTY_SET : oldIt->second;
+            differ |= oldId != pts.getId(it.first);
+        });
+        if (differ)
+            reactivate(it.first);
+    }
+
+    auto isNew = [&](char kind, const SVF::ConstraintEdge *edge) {
+        if (kind == 'g')
+            return !snapshot.gepEdges.count(gepKey(edge));
+        auto it = snapshot.edges.find(kind);
+        return it == snapshot.edges.end() || !it->second.count(snapshotKey(edge->getSrcID(), edge->getDstID()));
+    };
+    std::unordered_set<uint64_t> derivedKeys;
+    for (auto &edge : derivedEdges)
+        derivedKeys.insert(edgeKey(edge.first, edge.second));
+    unsigned newEdges = 0;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        SVF::ConstraintNode *node = it->second;
+        for (auto edge : node->getCopyOutEdges())
+        {
+            if (isNew('c', edge) && !derivedKeys.count(edgeKey(edge->getSrcID(), edge->getDstID())))
+            {
+                reactivate(edge->getSrcID());
+                newEdges++;
+            }
+        }
+        for (auto edge : node->getGepOutEdges())
+        {
+            if (isNew('g', edge))
+            {
+                reactivate(edge->getSrcID());
+                newEdges++;
+            }
+        }
+        // *p = q and r = *p depend on the objects of p
+        for (auto edge : node->getStoreOutEdges())
+        {
+            if (isNew('s', edge))
+            {
+                reactivate(edge->getDstID());
+                newEdges++;
+            }
+        }
+        for (auto edge : node->getLoadOutEdges())
+        {
+            if (isNew('l', edge))
+            {
+                reactivate(edge->getSrcID());
+                newEdges++;
+            }
+        }
+        for (auto edge : node->getAddrOutEdges())
+        {
+            if (isNew('a', edge))
+                newEdges++;
+        }
+    }
+    stats.newConstraints = newEdges;
+
+    // Addr edges that were solved before add nothing
+    seedAddrEdges(workList);
+    solve(workList);
+}
+
+
+bool Andersen::samePointsTo(const Andersen &other) const
+{
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        if (pts.at(findRep(it->first)) != other.pts.at(other.findRep(it->first)))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,163 @@
+/**
+ * NodeWorkList.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_NODEWORKLIST_H
+#define ANSWERS_NODEWORKLIST_H
+
+#include <cassert>
+#include <climits>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+/// Order in which the Andersen solver visits the nodes of its worklist
+enum class WorkListPolicy
+{
+    FIFO,   ///< first in, first out
+    LIFO,   ///< last in, first out
+    LRF,    ///< least recently fired node first
+    TOPO,   ///< nodes earlier in the topological order of the copy graph first
+    WAVE    ///< topological waves over copy/gep edges, then a pass over store/load constraints
+};
+
+
+/**
+ * Worklist of constraint nodes, ordered by a WorkListPolicy.
+ * Like WorkList, a node is held at most once.
+ */
+class NodeWorkList
+{
+public:
+    explicit NodeWorkList(WorkListPolicy policy) :
+            policy(policy)
+    {}
+
+    /// Check whether the worklist is empty.
+    inline bool empty() const
+    { return count == 0; }
+
+    /// Push a node, unless it is already in the worklist
+    bool push(unsigned id)
+    {
+        if (id >= inList.size())
+            inList.resize(id + 1, false);
+        if (inList[id])
+            return false;
+        inList[id] = true;
+        ++count;
+
+        if (policy == WorkListPolicy::FIFO || policy == WorkListPolicy::LIFO)
+            nodes.push_back(id);
+        else
+            heap.push({priorityOf(id), id});
+        return true;
+    }
+
+    /// Pop the next node according to the policy
+    unsigned pop()
+    {
+        assert(!empty() && "work list is empty");
+        unsigned id;
+        if (policy == WorkListPolicy::FIFO)
+        {
+            id = nodes.front();
+            nodes.pop_front();
+        }
+        else if (policy == WorkListPolicy::LIFO)
+        {
+            id = nodes.back();
+            nodes.pop_back();
+        }
+        else
+        {
+            // skip entries left behind by setPriority
+            while (!inList[heap.top().second] || heap.top().first != priorityOf(heap.top().second))
+                heap.pop();
+            id = heap.top().second;
+            heap.pop();
+        }
+        inList[id] = false;
+        --count;
+
+        ++pops;
+        if (policy == WorkListPolicy::LRF)
+        {
+            if (id >= lastFired.size())
+                lastFired.resize(id + 1, 0);
+            lastFired[id] = pops;
+        }
+        return id;
+    }
+
+    /// Set the topological rank of a node, reordering it if it is already in the worklist
+    void setPriority(unsigned id, unsigned rank)
+    {
+        if (id >= ranks.size())
+            ranks.resize(id + 1, UINT_MAX);
+        if (ranks[id] == rank)
+            return;
+        ranks[id] = rank;
+        if (id < inList.size() && inList[id])
+            heap.push({priorityOf(id), id});
+    }
+
+    /// Number of nodes popped so far
+    inline unsigned long getPops() const
+    { return pops; }
+
+    /// Parse a policy name given on the command line
+    static bool parsePolicy(const std::string &name, WorkListPolicy &policy)
+    {
+        static const std::pair<const char *, WorkListPolicy> names[] = {
+                {"fifo", WorkListPolicy::FIFO}, {"lifo", WorkListPolicy::LIFO}, {"lrf", WorkListPolicy::LRF},
+                {"topo", WorkListPolicy::TOPO}, {"wave", WorkListPolicy::WAVE}};
+        for (auto &entry : names)
+        {
+            if (name == entry.first)
+            {
+                policy = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static const char *policyName(WorkListPolicy policy)
+    {
+        switch (policy)
+        {
+            case WorkListPolicy::FIFO: return "fifo";
+            case WorkListPolicy::LIFO: return "lifo";
+            case WorkListPolicy::LRF: return "lrf";
+            case WorkListPolicy::TOPO: return "topo";
+            case WorkListPolicy::WAVE: return "wave";
+        }
+        return "unknown";
+    }
+
+private:
+    /// Heap key of a node: when it last fired for LRF, its topological rank for TOPO and WAVE
+    inline unsigned long priorityOf(unsigned id) const
+    {
+        if (policy == WorkListPolicy::LRF)
+            return id < lastFired.size() ? lastFired[id] : 0;
+        return id < ranks.size() ? ranks[id] : UINT_MAX;
+    }
+
+    using Entry = std::pair<unsigned long, unsigned>;   ///< (priority, node), smaller priority first
+
+    WorkListPolicy policy;
+    std::deque<unsigned> nodes;     ///< FIFO and LIFO
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;  ///< LRF, TOPO and WAVE
+    std::vector<bool> inList;
+    std::vector<unsigned long> lastFired;   ///< pop count when each node was last popped (LRF)
+    std::vector<unsigned> ranks;    ///< topological rank of each node (TOPO and WAVE)
+    unsigned count = 0;     ///< nodes currently in the worklist
+    unsigned long pops = 0;
+};
+
+#endif //ANSWERS_NODEWORKLIST_H
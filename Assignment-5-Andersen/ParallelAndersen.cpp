@@ -0,0 +1,290 @@
+/**
+ * ParallelAndersen.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/*
+ * Parallel solving mode.
+ *
+ * Solving proceeds in rounds. Within a round, the threads of the pool take nodes from per-thread work-stealing
+ * deques and propagate their deltas along copy and gep edges; points-to sets are guarded by a fixed array of
+ * sharded locks. Workers never change the constraint graph: the copy edges derived from store/load constraints
+ * and the field objects not created yet are recorded in per-thread batches, which the main thread applies
+ * between rounds, sorted. Copy edges only change there too, so all copy cycles reachable from the next frontier
+ * are collapsed before each round, as the wave policy does before each wave.
+ *
+ * A round runs the copy and gep edges to a fixpoint, so the objects reaching each node over a round, and with
+ * them the batches, do not depend on which thread did what. Field objects are created in the order of
+ * (gep edge, object), so the result file is the same for any number of threads above one. It differs from the
+ * sequential one in the numbering of the field objects only.
+ */
+
+namespace
+{
+
+/**
+ * Deque of one worker: the owner pushes at the back and pops at the front, so that its own nodes go in FIFO
+ * order as in the sequential solver; thieves steal from the back
+ */
+class StealingDeque
+{
+public:
+    inline void push(unsigned id)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        nodes.push_back(id);
+    }
+
+    inline bool pop(unsigned &id)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (nodes.empty())
+            return false;
+        id = nodes.front();
+        nodes.pop_front();
+        return true;
+    }
+
+    inline bool steal(unsigned &id)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (nodes.empty())
+            return false;
+        id = nodes.back();
+        nodes.pop_back();
+        return true;
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<unsigned> nodes;
+};
+
+/// What one worker derives during a round, applied by the main thread once the round is over
+struct RoundBatch
+{
+    std::vector<std::pair<unsigned, unsigned>> copyEdges;     ///< store/load-induced copy edges (src, dst)
+    std::vector<std::pair<unsigned, unsigned>> fieldRequests; ///< (gep edge, object) without a field object yet
+    unsigned long pops = 0;
+    unsigned long fieldMemoHits = 0;
+};
+
+constexpr unsigned LOCK_SHARDS = 1024;
+
+}
+
+
+void Andersen::solveParallel(NodeWorkList &workList)
+{
+    unsigned threads = pool->getThreads();
+    unsigned maxId = 0;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+        maxId = std::max(maxId, (unsigned) it->first);
+
+    std::vector<std::mutex> locks(LOCK_SHARDS);
+    std::vector<StealingDeque> deques(threads);
+    std::vector<RoundBatch> batches(threads);
+
+    // representatives with something to propagate, pushed by the sequential code or between rounds
+    std::vector<unsigned> changed;
+    while (!workList.empty())
+        changed.push_back(workList.pop());
+
+    std::vector<unsigned> frontier;
+    auto nextFrontier = [&]() {
+        // copy edges only change between rounds: with their cycles collapsed first, a round propagates over a DAG
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        for (auto rep : collapseCycles(changed))
+            changed.push_back(rep);
+
+        frontier.clear();
+        for (auto n : changed)
+        {
+            auto rep = getRep(n);
+            maxId = std::max(maxId, rep);
+            if (!deltaPts.at(rep).empty())
+                frontier.push_back(rep);
+        }
+        std::sort(frontier.begin(), frontier.end());
+        frontier.erase(std::unique(frontier.begin(), frontier.end()), frontier.end());
+        changed.clear();
+    };
+
+    for (nextFrontier(); !frontier.empty(); nextFrontier())
+    {
+        stats.parallelRounds++;
+
+        // no set may move while the workers update pts and deltaPts
+        pts.reserve(maxId + 1);
+        deltaPts.reserve(maxId + 1);
+        std::vector<std::atomic<bool>> queued(maxId + 1);
+        std::atomic<unsigned> pending(frontier.size());
+        for (size_t i = 0; i < frontier.size(); ++i)
+        {
+            queued[frontier[i]] = true;
+            deques[i % threads].push(frontier[i]);
+        }
+
+        // workers walk the side rows, so none may be left to sort on the way
+        csr.sortSideRows();
+        pool->runEach([&](unsigned self) {
+            RoundBatch &batch = batches[self];
+
+            auto addPtsLocked = [&](unsigned id, unsigned objsId) {
+                std::lock_guard<std::mutex> guard(locks[id % LOCK_SHARDS]);
+                return addPts(id, objsId);
+            };
+            auto push = [&](unsigned id) {
+                if (!queued[id].exchange(true))
+                {
+                    pending++;
+                    deques[self].push(id);
+                }
+            };
+
+            auto process = [&](unsigned p) {
+                queued[p] = false;
+                PointsTo delta;
+                {
+                    std::lock_guard<std::mutex> guard(locks[p % LOCK_SHARDS]);
+                    delta.swap(deltaPts[p]);
+                }
+                if (delta.empty())
+                    return;
+                unsigned deltaId = pts.getTable().intern(delta);
+
+                forEachMember(p, [&](unsigned n) {
+                    // q --Store--> p and p --Load--> r give copy edges q --> o and o --> r for o ∈ Δpts(p)
+                    csr.forEachStoreSource(n, [&](unsigned q) {
+                        for (auto o : delta)
+                            batch.copyEdges.emplace_back(q, o);
+                    });
+                    csr.forEachLoadTarget(n, [&](unsigned r) {
+                        for (auto o : delta)
+                            batch.copyEdges.emplace_back(o, r);
+                    });
+
+                    csr.forEachCopyTarget(n, [&](unsigned dst) {
+                        auto x = findRep(dst);
+                        if (x != p && addPtsLocked(x, deltaId))
+                            push(x);
+                    });
+
+                    csr.forEachGep(n, [&](unsigned gepId, unsigned dst) {
+                        const SVF::GepCGEdge *gepEdge = csr.getGepEdge(gepId);
+                        SVF::APOffset offset = csr.getGepOffset(gepId);
+                        PointsTo objs;
+                        for (auto o : delta)
+                        {
+                            auto fieldObj = findFieldObj(o, gepEdge, offset);
+                            if (fieldObj == ConstraintCSR::NO_NODE)
+                            {
+                                batch.fieldRequests.emplace_back(gepId, o);
+                                continue;
+                            }
+                            objs.insert(fieldObj);
+                            batch.fieldMemoHits++;
+                        }
+                        auto x = findRep(dst);
+                        if (!objs.empty() && addPtsLocked(x, pts.getTable().intern(objs)))
+                            push(x);
+                    });
+                });
+            };
+
+            while (true)
+            {
+                unsigned p;
+                bool found = deques[self].pop(p);
+                for (unsigned i = 1; !found && i < threads; ++i)
+                    found = deques[(self + i) % threads].steal(p);
+
+                if (found)
+                {
+                    process(p);
+                    batch.pops++;
+                    pending--;
+                }
+                else if (pending == 0)
+                {
+                    break;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        // apply the batches in a fixed order
+        RoundBatch round;
+        for (auto &batch : batches)
+        {
+            round.copyEdges.insert(round.copyEdges.end(), batch.copyEdges.begin(), batch.copyEdges.end());
+            round.fieldRequests.insert(round.fieldRequests.end(), batch.fieldRequests.begin(),
+                                       batch.fieldRequests.end());
+            stats.workListPops += batch.pops;
+            stats.fieldMemoHits += batch.fieldMemoHits;
+            batch = RoundBatch();
+        }
+        std::sort(round.copyEdges.begin(), round.copyEdges.end());
+        std::sort(round.fieldRequests.begin(), round.fieldRequests.end());
+        round.fieldRequests.erase(std::unique(round.fieldRequests.begin(), round.fieldRequests.end()),
+                                  round.fieldRequests.end());
+
+        // field objects are numbered in the order of (gep edge, object), whatever the schedule
+        for (auto &request : round.fieldRequests)
+        {
+            const SVF::GepCGEdge *gepEdge = csr.getGepEdge(request.first);
+            auto fieldObj = getFieldObj(request.second, gepEdge, csr.getGepOffset(request.first));
+            maxId = std::max(maxId, fieldObj);
+
+            PointsTo objs;
+            objs.insert(fieldObj);
+            auto x = getRep(gepEdge->getDstID());
+            if (addPts(x, objs))
+                changed.push_back(x);
+        }
+
+        for (auto &edge : round.copyEdges)
+        {
+            auto src = edge.first;
+            auto dst = edge.second;
+            if (!copyEdgeIndex.insert(edgeKey(src, dst)).second)
+            {
+                stats.duplicateCopyEdges++;
+                continue;
+            }
+
+            visitedNodes.insert(src);
+            derivedEdges.push_back(edge);
+            stats.derivedCopyEdges++;
+            if (isPruned(src))
+            {
+                // pts(src) stays empty, so the edge would never carry anything
+                reportedNodes.insert(dst);
+                continue;
+            }
+            addCopyEdge(src, dst);
+            if (propagate(getRep(src), getRep(dst)))
+                changed.push_back(getRep(dst));
+        }
+
+        if (!pendingCollapses.empty())
+        {
+            for (auto rep : mergeCollapsedFields())
+                changed.push_back(rep);
+        }
+
+        csr.compact();
+        checkpoint();
+    }
+}
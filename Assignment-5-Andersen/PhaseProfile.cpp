@@ -0,0 +1,79 @@
+/**
+ * PhaseProfile.cpp
+ * @author kisslune
+ */
+
+#include "PhaseProfile.h"
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+#include <sys/resource.h>
+
+void PhaseProfile::start(const std::string &name)
+{
+    stop();
+    running = name;
+    wallStart = wallNow();
+    cpuStart = cpuNow();
+}
+
+
+void PhaseProfile::stop()
+{
+    if (running.empty())
+        return;
+    phases.push_back({running, wallNow() - wallStart, cpuNow() - cpuStart, peakRssKb()});
+    running.clear();
+}
+
+
+long PhaseProfile::peakRssKb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss;     // KB on Linux
+}
+
+
+bool PhaseProfile::writeJson(const std::string &fname,
+                             const std::vector<std::pair<std::string, double>> &counters) const
+{
+    std::ofstream outFile(fname, std::ios::out);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return false;
+    }
+
+    outFile.precision(15);
+    outFile << "{\n  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); ++i)
+    {
+        outFile << (i ? ",\n" : "\n") << "    {\"name\": \"" << phases[i].name << "\", \"wall_s\": "
+                << phases[i].wallSeconds << ", \"cpu_s\": " << phases[i].cpuSeconds << ", \"peak_rss_kb\": "
+                << phases[i].peakRssKb << "}";
+    }
+    outFile << "\n  ],\n  \"peak_rss_kb\": " << peakRssKb() << ",\n  \"counters\": {";
+    for (size_t i = 0; i < counters.size(); ++i)
+        outFile << (i ? ",\n" : "\n") << "    \"" << counters[i].first << "\": " << counters[i].second;
+    outFile << "\n  }\n}\n";
+    return (bool) outFile;
+}
+
+
+double PhaseProfile::wallNow()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+double PhaseProfile::cpuNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,56 @@
+/**
+ * PhaseProfile.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_PHASEPROFILE_H
+#define ANSWERS_PHASEPROFILE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Wall and CPU time of the phases of a run, measured one after the other with start/stop.
+ * The peak resident set size is sampled at the end of each phase, so the phase that raises it shows up.
+ */
+class PhaseProfile
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        double wallSeconds;
+        double cpuSeconds;      ///< CPU time of all threads of the process
+        long peakRssKb;         ///< peak RSS of the process at the end of the phase
+    };
+
+    /// Start timing a phase, ending the running one if any
+    void start(const std::string &name);
+    /// End the running phase
+    void stop();
+
+    inline const std::vector<Phase> &getPhases() const
+    { return phases; }
+
+    /// Peak resident set size of the process so far, in KB
+    static long peakRssKb();
+
+    /**
+     * Write the phases, the peak RSS and the given counters to fname as a JSON object:
+     * {"phases": [{"name": .., "wall_s": .., "cpu_s": .., "peak_rss_kb": ..}, ..], "peak_rss_kb": ..,
+     *  "counters": {name: value, ..}}
+     */
+    bool writeJson(const std::string &fname, const std::vector<std::pair<std::string, double>> &counters) const;
+
+private:
+    static double wallNow();
+    static double cpuNow();
+
+    std::vector<Phase> phases;
+    std::string running;
+    double wallStart = 0;
+    double cpuStart = 0;
+};
+
+#endif //ANSWERS_PHASEPROFILE_H
@@ -0,0 +1,218 @@
+/**
+ * PointerEquivalence.cpp
+ * @author kisslune
+ */
+
+#include "A5Header.h"
+
+#include <climits>
+
+/*
+ * Offline variable substitution (hash-based value numbering, as in HVN/HU by Hardekopf and Lin).
+ *
+ * Every node gets a set of labels that symbolically describes its final points-to set:
+ *  - an Addr edge o --> n contributes the label of object o;
+ *  - a node whose set can also grow through edges added while solving (an object, which may be the target
+ *    of a store, or the target of a load) gets a fresh label of its own;
+ *  - a copy edge m --> n contributes all labels of m;
+ *  - a gep edge m --> n contributes one label per (label set of m, field), so equal bases give equal fields.
+ * Nodes with the same non-empty label set must end up with the same points-to set and are merged into one
+ * representative; nodes with an empty label set are never reached by an Addr edge and are pruned.
+ * The gep edges with a non-zero offset inside an SCC are recorded as positive-weight cycles.
+ */
+void Andersen::mergePointerEquivalents()
+{
+    std::vector<unsigned> nodes;
+    unsigned maxId = 0;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        nodes.push_back(it->first);
+        maxId = std::max(maxId, (unsigned) it->first);
+    }
+
+    // successors over copy and gep edges, which are the edges that move sets between pointers
+    auto succsOf = [&](unsigned n) {
+        std::vector<unsigned> succs;
+        SVF::ConstraintNode *node = consg->getConstraintNode(n);
+        for (auto edge : node->getCopyOutEdges())
+            succs.push_back(edge->getDstID());
+        for (auto edge : node->getGepOutEdges())
+            succs.push_back(edge->getDstID());
+        return succs;
+    };
+
+    // iterative Tarjan; SCCs come out in reverse topological order
+    std::vector<unsigned> index(maxId + 1, UINT_MAX);
+    std::vector<unsigned> lowLink(maxId + 1, 0);
+    std::vector<bool> onStack(maxId + 1, false);
+    std::vector<unsigned> sccOf(maxId + 1, 0);
+    std::vector<std::vector<unsigned>> sccs;
+    std::vector<unsigned> sccStack;
+    std::vector<std::pair<unsigned, std::vector<unsigned>>> callStack;
+    std::vector<size_t> nextSucc;
+    unsigned counter = 0;
+
+    for (auto root : nodes)
+    {
+        if (index[root] != UINT_MAX)
+            continue;
+
+        auto visit = [&](unsigned n) {
+            index[n] = lowLink[n] = counter++;
+            sccStack.push_back(n);
+            onStack[n] = true;
+            callStack.emplace_back(n, succsOf(n));
+            nextSucc.push_back(0);
+        };
+
+        visit(root);
+        while (!callStack.empty())
+        {
+            auto n = callStack.back().first;
+            auto &succs = callStack.back().second;
+            if (nextSucc.back() < succs.size())
+            {
+                auto succ = succs[nextSucc.back()++];
+                if (index[succ] == UINT_MAX)
+                    visit(succ);
+                else if (onStack[succ])
+                    lowLink[n] = std::min(lowLink[n], index[succ]);
+                continue;
+            }
+
+            callStack.pop_back();
+            nextSucc.pop_back();
+            if (!callStack.empty())
+            {
+                auto parent = callStack.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[n]);
+            }
+
+            if (lowLink[n] == index[n])
+            {
+                sccs.emplace_back();
+                while (true)
+                {
+                    auto m = sccStack.back();
+                    sccStack.pop_back();
+                    onStack[m] = false;
+                    sccOf[m] = sccs.size() - 1;
+                    sccs.back().push_back(m);
+                    if (m == n)
+                        break;
+                }
+            }
+        }
+    }
+
+    // Labels below maxId + 1 are object IDs; fresh labels are allocated above them
+    unsigned nextLabel = maxId + 1;
+    std::map<std::vector<unsigned>, unsigned> labelSetIds;     // hash-consed label sets, ID 0 is the empty set
+    std::vector<const std::vector<unsigned> *> labelSets;
+    std::map<std::pair<unsigned, SVF::s64_t>, unsigned> gepLabels;
+    std::vector<unsigned> labelSetOf(maxId + 1, 0);
+
+    auto internLabels = [&](std::vector<unsigned> &labels) {
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        auto res = labelSetIds.emplace(labels, labelSetIds.size());
+        if (res.second)
+            labelSets.push_back(&res.first->first);
+        return res.first->second;
+    };
+    std::vector<unsigned> noLabels;
+    internLabels(noLabels);
+
+    // a node whose set may also grow through copy edges added while solving
+    SVF::SVFIR *pag = SVF::PAG::getPAG();
+    auto growsWhileSolving = [&](SVF::ConstraintNode *node) {
+        return SVF::SVFUtil::isa<SVF::ObjVar>(pag->getGNode(node->getId())) || !node->getAddrOutEdges().empty() ||
+               !node->getLoadInEdges().empty();
+    };
+
+    // predecessors are labelled before their successors
+    for (auto sccIt = sccs.rbegin(); sccIt != sccs.rend(); ++sccIt)
+    {
+        auto &scc = *sccIt;
+        auto sccId = sccOf[scc.front()];
+
+        // a gep inside the SCC would make its label depend on itself: give every member a label of its own
+        bool internalGep = false;
+        for (auto n : scc)
+        {
+            for (auto edge : consg->getConstraintNode(n)->getGepOutEdges())
+            {
+                if (sccOf[edge->getDstID()] != sccId)
+                    continue;
+                internalGep = true;
+
+                // a non-zero offset on a cycle reaches ever larger fields: a positive-weight cycle
+                auto *normalGep = SVF::SVFUtil::dyn_cast<SVF::NormalGepCGEdge>(edge);
+                if (normalGep && normalGep->getConstantFieldIdx() != 0)
+                    pwcGepEdges.emplace(edge->getSrcID(), edge->getDstID(), normalGep->getConstantFieldIdx());
+            }
+        }
+        if (internalGep)
+        {
+            for (auto n : scc)
+            {
+                std::vector<unsigned> labels{nextLabel++};
+                labelSetOf[n] = internLabels(labels);
+            }
+            continue;
+        }
+
+        // all members of a copy cycle share one label set
+        std::vector<unsigned> labels;
+        for (auto n : scc)
+        {
+            SVF::ConstraintNode *node = consg->getConstraintNode(n);
+            if (growsWhileSolving(node))
+                labels.push_back(nextLabel++);
+            for (auto edge : node->getAddrInEdges())
+                labels.push_back(edge->getSrcID());
+            for (auto edge : node->getCopyInEdges())
+            {
+                auto src = edge->getSrcID();
+                if (sccOf[src] != sccId)
+                {
+                    auto *srcLabels = labelSets[labelSetOf[src]];
+                    labels.insert(labels.end(), srcLabels->begin(), srcLabels->end());
+                }
+            }
+            for (auto edge : node->getGepInEdges())
+            {
+                auto src = edge->getSrcID();
+                if (labelSetOf[src] == 0)
+                    continue;
+                // variant geps always yield the field-insensitive object, so they share one key
+                SVF::s64_t field = -1;
+                if (auto *normalGep = SVF::SVFUtil::dyn_cast<SVF::NormalGepCGEdge>(edge))
+                    field = normalGep->getConstantFieldIdx();
+                auto res = gepLabels.emplace(std::make_pair(labelSetOf[src], field), nextLabel);
+                if (res.second)
+                    nextLabel++;
+                labels.push_back(res.first->second);
+            }
+        }
+
+        auto setId = internLabels(labels);
+        for (auto n : scc)
+            labelSetOf[n] = setId;
+    }
+
+    // merge nodes with equal label sets; prune those without labels
+    prunedNodes.assign(maxId + 1, false);
+    std::unordered_map<unsigned, unsigned> repOfLabelSet;
+    for (auto n : nodes)
+    {
+        if (labelSetOf[n] == 0)
+        {
+            prunedNodes[n] = true;
+            continue;
+        }
+        auto res = repOfLabelSet.emplace(labelSetOf[n], n);
+        if (!res.second)
+            mergeNode(res.first->second, n);
+    }
+}
@@ -0,0 +1,421 @@
+/**
+ * PointsTo.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_POINTSTO_H
+#define ANSWERS_POINTSTO_H
+
+#include "BitKernels.h"
+
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/**
+ * Sparse bit-vector points-to set.
+ *
+ * Like LLVM's SparseBitVector, the bit space is cut into fixed-size elements and only non-zero elements are
+ * stored. Elements are kept sorted by index in two parallel arrays (indices and bit words) so that set
+ * operations are linear merges over contiguous memory, and iteration yields members in ascending order.
+ * Runs of elements present in both operands are handed to the word kernels of BitKernels as one block, so
+ * dense sets (e.g. of hub nodes) are or-ed, and-ed and counted with SIMD instructions.
+ */
+class PointsTo
+{
+public:
+    using Word = uint64_t;
+
+    static constexpr unsigned WORD_BITS = 64;
+    static constexpr unsigned ELEMENT_WORDS = 2;
+    static constexpr unsigned ELEMENT_BITS = WORD_BITS * ELEMENT_WORDS;
+    /// Shorter runs of words are handled inline, as a kernel call would cost more than it saves
+    static constexpr size_t KERNEL_MIN_WORDS = 8;
+
+    /// Forward iterator over the members of a set, in ascending order
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = unsigned;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const unsigned *;
+        using reference = unsigned;
+
+        const_iterator(const PointsTo *set, size_t elem) :
+                set(set), elem(elem), bit(0)
+        { seek(); }
+
+        inline unsigned operator*() const
+        { return set->indices[elem] * ELEMENT_BITS + bit; }
+
+        inline const_iterator &operator++()
+        {
+            ++bit;
+            seek();
+            return *this;
+        }
+
+        inline bool operator==(const const_iterator &rhs) const
+        { return elem == rhs.elem && bit == rhs.bit; }
+
+        inline bool operator!=(const const_iterator &rhs) const
+        { return !(*this == rhs); }
+
+    private:
+        /// Move to the first set bit at or after the current position
+        void seek()
+        {
+            for (; elem < set->indices.size(); ++elem, bit = 0)
+            {
+                for (; bit < ELEMENT_BITS; bit = (bit / WORD_BITS + 1) * WORD_BITS)
+                {
+                    Word w = set->words[elem * ELEMENT_WORDS + bit / WORD_BITS] >> (bit % WORD_BITS);
+                    if (w)
+                    {
+                        bit += __builtin_ctzll(w);
+                        return;
+                    }
+                }
+            }
+            bit = 0;
+        }
+
+        const PointsTo *set;
+        size_t elem;
+        unsigned bit;
+    };
+
+    inline const_iterator begin() const
+    { return const_iterator(this, 0); }
+
+    inline const_iterator end() const
+    { return const_iterator(this, indices.size()); }
+
+    /// Check whether the set is empty
+    inline bool empty() const
+    { return indices.empty(); }
+
+    /// Number of members
+    unsigned size() const
+    {
+        if (words.size() >= KERNEL_MIN_WORDS)
+            return bitKernels().popcountWords(words.data(), words.size());
+        unsigned n = 0;
+        for (Word w : words)
+            n += __builtin_popcountll(w);
+        return n;
+    }
+
+    inline void clear()
+    {
+        indices.clear();
+        words.clear();
+    }
+
+    /// Clear the set and give its storage back
+    inline void release()
+    {
+        std::vector<unsigned>().swap(indices);
+        std::vector<Word>().swap(words);
+    }
+
+    /// Heap bytes held by the set
+    inline size_t memoryBytes() const
+    { return indices.capacity() * sizeof(unsigned) + words.capacity() * sizeof(Word); }
+
+    /**
+     * Append the set to out as LEB128 varints: the number of elements, then per element the gap from the
+     * previous index and its words (sparse words are short, which is what makes spilled sets small)
+     */
+    void encode(std::vector<uint8_t> &out) const
+    {
+        appendVarint(out, indices.size());
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            appendVarint(out, i ? indices[i] - indices[i - 1] : indices[i]);
+            for (unsigned k = 0; k < ELEMENT_WORDS; ++k)
+                appendVarint(out, words[i * ELEMENT_WORDS + k]);
+        }
+    }
+
+    /// Replace the set by the one encoded at in; returns the end of the encoding
+    const uint8_t *decode(const uint8_t *in)
+    {
+        size_t n = readVarint(in);
+        indices.resize(n);
+        words.resize(n * ELEMENT_WORDS);
+        for (size_t i = 0; i < n; ++i)
+        {
+            indices[i] = (i ? indices[i - 1] : 0) + readVarint(in);
+            for (unsigned k = 0; k < ELEMENT_WORDS; ++k)
+                words[i * ELEMENT_WORDS + k] = readVarint(in);
+        }
+        return in;
+    }
+
+    /// Check whether id is a member
+    bool test(unsigned id) const
+    {
+        size_t pos = lowerBound(id / ELEMENT_BITS);
+        if (pos == indices.size() || indices[pos] != id / ELEMENT_BITS)
+            return false;
+        return (wordOf(pos, id) >> (id % WORD_BITS)) & 1;
+    }
+
+    /// Add id to the set; returns true if it was not a member before
+    bool insert(unsigned id)
+    {
+        unsigned idx = id / ELEMENT_BITS;
+        size_t pos = lowerBound(idx);
+        if (pos == indices.size() || indices[pos] != idx)
+        {
+            indices.insert(indices.begin() + pos, idx);
+            words.insert(words.begin() + pos * ELEMENT_WORDS, ELEMENT_WORDS, 0);
+        }
+        Word &w = wordOf(pos, id);
+        Word mask = Word(1) << (id % WORD_BITS);
+        if (w & mask)
+            return false;
+        w |= mask;
+        return true;
+    }
+
+    /**
+     * Union rhs into this set, word by word
+     * @return true if this set changed
+     */
+    bool unionWith(const PointsTo &rhs)
+    {
+        if (rhs.empty() || this == &rhs)
+            return false;
+
+        // Fast path: every element of rhs already exists here, so OR in place
+        bool subsumed = true;
+        for (size_t i = 0, j = 0; j < rhs.indices.size(); ++j)
+        {
+            while (i < indices.size() && indices[i] < rhs.indices[j])
+                ++i;
+            if (i == indices.size() || indices[i] != rhs.indices[j])
+            {
+                subsumed = false;
+                break;
+            }
+        }
+
+        if (subsumed)
+        {
+            bool changed = false;
+            for (size_t i = 0, j = 0; j < rhs.indices.size();)
+            {
+                while (indices[i] < rhs.indices[j])
+                    ++i;
+                size_t run = matchingRun(rhs, i, j);
+                changed |= unionWords(&words[i * ELEMENT_WORDS], &rhs.words[j * ELEMENT_WORDS],
+                                      run * ELEMENT_WORDS);
+                i += run;
+                j += run;
+            }
+            return changed;
+        }
+
+        // Slow path: merge both element lists into fresh arrays; rhs brings at least one new element
+        std::vector<unsigned> mergedIndices;
+        std::vector<Word> mergedWords;
+        mergedIndices.reserve(indices.size() + rhs.indices.size());
+        mergedWords.reserve((indices.size() + rhs.indices.size()) * ELEMENT_WORDS);
+        size_t i = 0, j = 0;
+        while (i < indices.size() || j < rhs.indices.size())
+        {
+            if (j == rhs.indices.size() || (i < indices.size() && indices[i] < rhs.indices[j]))
+            {
+                mergedIndices.push_back(indices[i]);
+                mergedWords.insert(mergedWords.end(), &words[i * ELEMENT_WORDS], &words[(i + 1) * ELEMENT_WORDS]);
+                ++i;
+            }
+            else if (i == indices.size() || rhs.indices[j] < indices[i])
+            {
+                mergedIndices.push_back(rhs.indices[j]);
+                mergedWords.insert(mergedWords.end(), &rhs.words[j * ELEMENT_WORDS],
+                                   &rhs.words[(j + 1) * ELEMENT_WORDS]);
+                ++j;
+            }
+            else
+            {
+                size_t run = matchingRun(rhs, i, j);
+                mergedIndices.insert(mergedIndices.end(), &indices[i], &indices[i] + run);
+                size_t at = mergedWords.size();
+                mergedWords.insert(mergedWords.end(), &words[i * ELEMENT_WORDS],
+                                   &words[i * ELEMENT_WORDS] + run * ELEMENT_WORDS);
+                unionWords(&mergedWords[at], &rhs.words[j * ELEMENT_WORDS], run * ELEMENT_WORDS);
+                i += run;
+                j += run;
+            }
+        }
+        indices.swap(mergedIndices);
+        words.swap(mergedWords);
+        return true;
+    }
+
+    /// Set this to lhs - rhs
+    void intersectWithComplement(const PointsTo &lhs, const PointsTo &rhs)
+    {
+        assert(this != &lhs && this != &rhs && "operands must be distinct from the result");
+        clear();
+        for (size_t i = 0, j = 0; i < lhs.indices.size(); ++i)
+        {
+            while (j < rhs.indices.size() && rhs.indices[j] < lhs.indices[i])
+                ++j;
+            bool shared = j < rhs.indices.size() && rhs.indices[j] == lhs.indices[i];
+
+            Word diff[ELEMENT_WORDS];
+            Word any = 0;
+            for (unsigned k = 0; k < ELEMENT_WORDS; ++k)
+            {
+                diff[k] = lhs.words[i * ELEMENT_WORDS + k];
+                if (shared)
+                    diff[k] &= ~rhs.words[j * ELEMENT_WORDS + k];
+                any |= diff[k];
+            }
+            if (any)
+            {
+                indices.push_back(lhs.indices[i]);
+                words.insert(words.end(), diff, diff + ELEMENT_WORDS);
+            }
+        }
+    }
+
+    /// Check whether this set and rhs share a member; stops at the first common word
+    bool intersects(const PointsTo &rhs) const
+    {
+        size_t i = 0, j = 0;
+        while (i < indices.size() && j < rhs.indices.size())
+        {
+            if (indices[i] < rhs.indices[j])
+            {
+                ++i;
+            }
+            else if (rhs.indices[j] < indices[i])
+            {
+                ++j;
+            }
+            else
+            {
+                size_t run = matchingRun(rhs, i, j);
+                if (intersectsWords(&words[i * ELEMENT_WORDS], &rhs.words[j * ELEMENT_WORDS], run * ELEMENT_WORDS))
+                    return true;
+                i += run;
+                j += run;
+            }
+        }
+        return false;
+    }
+
+    inline void swap(PointsTo &rhs)
+    {
+        indices.swap(rhs.indices);
+        words.swap(rhs.words);
+    }
+
+    /// Hash of the members, for hash-consing
+    size_t hash() const
+    {
+        size_t h = indices.size();
+        for (size_t i = 0; i < indices.size(); ++i)
+        {
+            h = h * 0x100000001b3ULL ^ indices[i];
+            for (unsigned k = 0; k < ELEMENT_WORDS; ++k)
+                h = (h ^ words[i * ELEMENT_WORDS + k]) * 0x9e3779b97f4a7c15ULL;
+        }
+        return h;
+    }
+
+    inline bool operator==(const PointsTo &rhs) const
+    { return indices == rhs.indices && words == rhs.words; }
+
+    inline bool operator!=(const PointsTo &rhs) const
+    { return !(*this == rhs); }
+
+private:
+    /// Number of elements from indices[i] and rhs.indices[j] on whose indices are the same; at least 1
+    inline size_t matchingRun(const PointsTo &rhs, size_t i, size_t j) const
+    {
+        size_t run = 1;
+        while (i + run < indices.size() && j + run < rhs.indices.size() &&
+               indices[i + run] == rhs.indices[j + run])
+            ++run;
+        return run;
+    }
+
+    /// dst |= src over n words; returns true if dst changed
+    static inline bool unionWords(Word *dst, const Word *src, size_t n)
+    {
+        if (n >= KERNEL_MIN_WORDS)
+            return bitKernels().unionWords(dst, src, n);
+        Word added = 0;
+        for (size_t k = 0; k < n; ++k)
+        {
+            added |= src[k] & ~dst[k];
+            dst[k] |= src[k];
+        }
+        return added != 0;
+    }
+
+    static inline bool intersectsWords(const Word *a, const Word *b, size_t n)
+    {
+        if (n >= KERNEL_MIN_WORDS)
+            return bitKernels().intersectsWords(a, b, n);
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (a[k] & b[k])
+                return true;
+        }
+        return false;
+    }
+
+    static void appendVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            out.push_back((uint8_t) (value | 0x80));
+        out.push_back((uint8_t) value);
+    }
+
+    static uint64_t readVarint(const uint8_t *&in)
+    {
+        uint64_t value = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            uint8_t byte = *in++;
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+
+    /// Position of the first element whose index is not less than idx
+    size_t lowerBound(unsigned idx) const
+    {
+        size_t lo = 0, hi = indices.size();
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (indices[mid] < idx)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    inline Word &wordOf(size_t pos, unsigned id)
+    { return words[pos * ELEMENT_WORDS + (id % ELEMENT_BITS) / WORD_BITS]; }
+
+    inline Word wordOf(size_t pos, unsigned id) const
+    { return words[pos * ELEMENT_WORDS + (id % ELEMENT_BITS) / WORD_BITS]; }
+
+    std::vector<unsigned> indices;  ///< element indices, ascending
+    std::vector<Word> words;        ///< ELEMENT_WORDS bit words per element
+};
+
+#endif //ANSWERS_POINTSTO_H
@@ -0,0 +1,432 @@
+/**
+ * PointsToTable.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_POINTSTOTABLE_H
+#define ANSWERS_POINTSTOTABLE_H
+
+#include "PointsTo.h"
+#include "SpillFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+/// Approximate bytes of an unordered map or set: a node per element (value, next pointer and cached hash)
+/// plus the bucket array
+template<class HashTable>
+inline size_t hashTableBytes(const HashTable &table)
+{
+    return table.size() * (sizeof(typename HashTable::value_type) + 2 * sizeof(void *)) +
+           table.bucket_count() * sizeof(void *);
+}
+
+
+/**
+ * Hash-consing table of points-to sets.
+ *
+ * Every distinct set is stored once, as an immutable canonical copy identified by a set ID; ID 0 is the
+ * empty set. Unions of two sets are memoized by their pair of IDs, so repeating a union is one lookup.
+ * The table may be used from several threads: sets live in a deque, so references to them stay valid
+ * while new sets are added.
+ *
+ * With a memory budget, sets that have not been read for a while are encoded into a SpillFile and dropped
+ * from memory whenever the memory counted at a checkpoint outgrows the budget; get() faults a spilled set back
+ * in. Canonical sets never change, so a set is written to the file once and later spills only drop it.
+ * Resident sets are kept in a list ordered by when they were listed; get() only stamps a set, and a stamped
+ * set found at the old end of the list is moved to the front instead of being spilled (lazy LRU).
+ *
+ * Sets that no node holds any more are freed by collect(), which the solver calls between pops with the IDs
+ * it holds; freed IDs are given to new sets, and the union memo forgets the unions that involve them.
+ */
+class PointsToTable
+{
+public:
+    static constexpr unsigned EMPTY_SET = 0;
+
+    PointsToTable()
+    {
+        // the entry of the empty set is never listed: it is the head of the list of resident sets
+        sets.emplace_back(PointsTo());
+        sets.front().prev = sets.front().next = EMPTY_SET;
+        index.emplace(sets.front().set.hash(), EMPTY_SET);
+    }
+
+    PointsToTable(const PointsToTable &) = delete;
+    PointsToTable &operator=(const PointsToTable &) = delete;
+
+    /// Get the ID of the canonical copy of set, adding it to the table if needed
+    unsigned intern(const PointsTo &set)
+    {
+        if (set.empty())
+            return EMPTY_SET;
+
+        size_t h = set.hash();
+        {
+            std::shared_lock<std::shared_mutex> guard(mutex);
+            unsigned id = find(set, h);
+            if (id != NOT_FOUND)
+                return id;
+        }
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        return insert(set, h);
+    }
+
+    /// Get the set of an ID, faulting it in if it was spilled
+    inline const PointsTo &get(unsigned id) const
+    {
+        std::shared_lock<std::shared_mutex> guard(mutex);
+        Entry &entry = sets[id];
+        entry.lastUse.store(clock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        if (!entry.spilled.load(std::memory_order_acquire))
+            return entry.set;
+        guard.unlock();
+        std::unique_lock<std::shared_mutex> exclusive(mutex);
+        refault(id);
+        return entry.set;
+    }
+
+    /**
+     * Spill the least recently read sets to a file in dir once the memory counted at a checkpoint is more than
+     * budgetBytes
+     * @return false if the file cannot be created
+     */
+    bool enableSpill(size_t budgetBytes, const std::string &dir)
+    {
+        budget = budgetBytes;
+        return spillFile.open(dir);
+    }
+
+    /// Budget of the spilling, 0 for none
+    inline size_t getBudget() const
+    { return budget; }
+
+    /**
+     * Start a new period of use. With a budget, count the resident sets, the index and union memo of the table
+     * and otherBytes (what the caller holds besides the table); if that is over budget, spill the least
+     * recently read sets down to 3/4 of it.
+     * Called by the solver between worklist pops: no reference returned by get may be held across it.
+     */
+    void checkpoint(size_t otherBytes = 0)
+    {
+        clock.fetch_add(1, std::memory_order_relaxed);
+        if (!budget)
+            return;
+
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        size_t counted = residentBytes + tableBytes() + otherBytes;
+        peakCountedBytes = std::max(peakCountedBytes, counted);
+        if (counted <= budget)
+            return;
+
+        uint64_t appendedFrom = spillFile.size();
+        std::vector<uint8_t> bytes;
+        for (unsigned id = sets[EMPTY_SET].prev; id != EMPTY_SET && counted > budget - budget / 4;
+             id = sets[EMPTY_SET].prev)
+        {
+            Entry &entry = sets[id];
+            unlink(id);
+            // read since it was listed: give it a second chance at the front
+            unsigned lastUse = entry.lastUse.load(std::memory_order_relaxed);
+            if (lastUse != entry.listedAt)
+            {
+                pushFront(id, lastUse);
+                continue;
+            }
+
+            if (entry.spillOffset == SpillFile::NO_OFFSET)
+            {
+                bytes.clear();
+                entry.set.encode(bytes);
+                entry.spillOffset = spillFile.append(bytes);
+                if (entry.spillOffset == SpillFile::NO_OFFSET)
+                {
+                    pushFront(id, lastUse);
+                    break;
+                }
+            }
+            counted -= entry.set.memoryBytes();
+            residentBytes -= entry.set.memoryBytes();
+            entry.set.release();
+            entry.spilled.store(true, std::memory_order_relaxed);
+            spills++;
+        }
+        spillFile.dropPages(appendedFrom);
+    }
+
+    /// Check whether enough sets were added since the last collect for another one, over numRoots IDs, to pay off
+    inline bool wantsCollect(size_t numRoots) const
+    { return addedSinceCollect >= std::max({(size_t) 1024, liveAfterCollect, numRoots / 4}); }
+
+    /**
+     * Free the sets whose IDs are not in roots and drop the union memo entries that involve them; the memo is
+     * cleared if it still holds more than MEMO_ENTRIES_PER_SET entries per live set.
+     * Called between worklist pops, with every set ID the caller holds in roots.
+     * @return the number of sets freed
+     */
+    size_t collect(const std::vector<unsigned> &roots)
+    {
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        std::vector<bool> live(sets.size(), false);
+        live[EMPTY_SET] = true;
+        for (auto id : roots)
+            live[id] = true;
+
+        size_t freed = 0;
+        for (unsigned id = EMPTY_SET + 1; id < sets.size(); ++id)
+        {
+            Entry &entry = sets[id];
+            if (live[id] || entry.freed)
+                continue;
+            auto range = index.equal_range(entry.hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second == id)
+                {
+                    index.erase(it);
+                    break;
+                }
+            }
+            if (!entry.spilled.load(std::memory_order_relaxed))
+            {
+                unlink(id);
+                residentBytes -= entry.set.memoryBytes();
+                entry.set.release();
+            }
+            entry.spilled.store(false, std::memory_order_relaxed);
+            entry.spillOffset = SpillFile::NO_OFFSET;
+            entry.freed = true;
+            freeIds.push_back(id);
+            freed++;
+        }
+
+        // a memoized union naming a freed set would hand out an ID that is about to be reused
+        auto isFreed = [&](unsigned id) { return sets[id].freed; };
+        for (auto it = unionMemo.begin(); it != unionMemo.end();)
+        {
+            if (isFreed(it->first >> 32) || isFreed((uint32_t) it->first) || isFreed(it->second))
+                it = unionMemo.erase(it);
+            else
+                ++it;
+        }
+        liveAfterCollect = sets.size() - freeIds.size();
+        if (unionMemo.size() > MEMO_ENTRIES_PER_SET * liveAfterCollect)
+            std::unordered_map<uint64_t, unsigned>().swap(unionMemo);
+
+        addedSinceCollect = 0;
+        collected += freed;
+        return freed;
+    }
+
+    /// Get the ID of the union of two sets, computing it only the first time the pair is seen
+    unsigned unionOf(unsigned lhs, unsigned rhs)
+    {
+        if (lhs == rhs || rhs == EMPTY_SET)
+            return lhs;
+        if (lhs == EMPTY_SET)
+            return rhs;
+
+        // union is commutative: order the pair so that both orders share an entry
+        uint64_t key = lhs < rhs ? ((uint64_t) lhs << 32) | rhs : ((uint64_t) rhs << 32) | lhs;
+        {
+            std::shared_lock<std::shared_mutex> guard(mutex);
+            auto it = unionMemo.find(key);
+            if (it != unionMemo.end())
+            {
+                memoHits++;
+                return it->second;
+            }
+        }
+
+        // canonical sets never change, so the union can be computed without holding the lock
+        PointsTo result = get(lhs);
+        result.unionWith(get(rhs));
+        size_t h = result.hash();
+
+        std::unique_lock<std::shared_mutex> guard(mutex);
+        memoMisses++;
+        unsigned id = insert(result, h);
+        unionMemo.emplace(key, id);
+        return id;
+    }
+
+    /// Number of distinct sets not freed, including the empty set
+    inline size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> guard(mutex);
+        return sets.size() - freeIds.size();
+    }
+
+    /// Number of sets freed by collect so far
+    inline unsigned long getCollected() const
+    { return collected; }
+
+    inline unsigned long getMemoHits() const
+    { return memoHits; }
+
+    inline unsigned long getMemoMisses() const
+    { return memoMisses; }
+
+    inline unsigned long getSpills() const
+    { return spills; }
+
+    inline unsigned long getRefaults() const
+    { return refaults; }
+
+    /// Largest number of bytes held by resident sets at any time
+    inline size_t getPeakResidentBytes() const
+    { return peakResidentBytes; }
+
+    /// Largest number of bytes counted against the budget at a checkpoint
+    inline size_t getPeakCountedBytes() const
+    { return peakCountedBytes; }
+
+    inline uint64_t getSpillFileBytes() const
+    { return spillFile.size(); }
+
+private:
+    static constexpr unsigned NOT_FOUND = ~0u;
+    static constexpr size_t MEMO_ENTRIES_PER_SET = 4;
+
+    /// A canonical set; while spilled, set is empty and its members are at spillOffset in the spill file
+    struct Entry
+    {
+        explicit Entry(const PointsTo &set) :
+                set(set)
+        {}
+
+        PointsTo set;
+        std::atomic<unsigned> lastUse{0};       ///< clock of the last get
+        std::atomic<bool> spilled{false};
+        uint64_t spillOffset = SpillFile::NO_OFFSET;
+        size_t hash = 0;
+        bool freed = false;         ///< freed by collect; the ID is in freeIds
+        unsigned listedAt = 0;      ///< lastUse when the set was put at the front of the list
+        unsigned prev = EMPTY_SET;  ///< neighbours in the list of resident sets, newest first
+        unsigned next = EMPTY_SET;
+    };
+
+    /// Read a spilled set back from the spill file; the caller holds the lock exclusively
+    void refault(unsigned id) const
+    {
+        Entry &entry = sets[id];
+        if (!entry.spilled.load(std::memory_order_relaxed))
+            return;
+        entry.set.decode(spillFile.data(entry.spillOffset));
+        addResident(entry.set.memoryBytes());
+        entry.spilled.store(false, std::memory_order_release);
+        refaults++;
+        pushFront(id, entry.lastUse.load(std::memory_order_relaxed));
+    }
+
+    /// Put a resident set at the front of the list; the caller holds the lock exclusively
+    void pushFront(unsigned id, unsigned lastUse) const
+    {
+        Entry &entry = sets[id];
+        Entry &head = sets[EMPTY_SET];
+        entry.listedAt = lastUse;
+        entry.prev = EMPTY_SET;
+        entry.next = head.next;
+        sets[head.next].prev = id;
+        head.next = id;
+    }
+
+    /// Take a set out of the list; the caller holds the lock exclusively
+    void unlink(unsigned id) const
+    {
+        Entry &entry = sets[id];
+        sets[entry.prev].next = entry.next;
+        sets[entry.next].prev = entry.prev;
+    }
+
+    /// Bytes of the table itself: the entries, the index and the union memo
+    size_t tableBytes() const
+    {
+        return sets.size() * sizeof(Entry) + freeIds.capacity() * sizeof(unsigned) + hashTableBytes(index) +
+               hashTableBytes(unionMemo);
+    }
+
+    /// Compare the set of an entry with set, without faulting it in; the caller holds the lock
+    bool equals(const Entry &entry, const PointsTo &set) const
+    {
+        if (!entry.spilled.load(std::memory_order_acquire))
+            return entry.set == set;
+        PointsTo spilled;
+        spilled.decode(spillFile.data(entry.spillOffset));
+        return spilled == set;
+    }
+
+    inline void addResident(size_t bytes) const
+    {
+        residentBytes += bytes;
+        peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+    }
+
+    /// Look set up by its hash; the caller holds the lock
+    unsigned find(const PointsTo &set, size_t h) const
+    {
+        auto range = index.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (equals(sets[it->second], set))
+                return it->second;
+        }
+        return NOT_FOUND;
+    }
+
+    /// Add set unless an equal one exists; the caller holds the lock exclusively
+    unsigned insert(const PointsTo &set, size_t h)
+    {
+        unsigned id = find(set, h);
+        if (id != NOT_FOUND)
+            return id;
+        if (freeIds.empty())
+        {
+            id = sets.size();
+            sets.emplace_back(set);
+        }
+        else
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+            sets[id].set = set;
+            sets[id].freed = false;
+        }
+        Entry &entry = sets[id];
+        entry.hash = h;
+        addResident(entry.set.memoryBytes());
+        unsigned now = clock.load(std::memory_order_relaxed);
+        entry.lastUse.store(now, std::memory_order_relaxed);
+        pushFront(id, now);
+        index.emplace(h, id);
+        addedSinceCollect++;
+        return id;
+    }
+
+    mutable std::shared_mutex mutex;
+    /// set ID -> canonical set; faulting a set in does not change it, so get and refault are const
+    mutable std::deque<Entry> sets;
+    std::unordered_multimap<size_t, unsigned> index;    ///< hash -> IDs of the sets with that hash
+    std::unordered_map<uint64_t, unsigned> unionMemo;   ///< (smaller ID, larger ID) -> ID of the union
+    std::vector<unsigned> freeIds;      ///< IDs of the sets freed by collect, reused first
+    size_t addedSinceCollect = 0;
+    size_t liveAfterCollect = 0;
+    unsigned long collected = 0;
+    std::atomic<unsigned long> memoHits{0};
+    std::atomic<unsigned long> memoMisses{0};
+
+    size_t budget = 0;                  ///< bytes counted at a checkpoint that trigger spilling; 0 for no limit
+    mutable SpillFile spillFile;
+    mutable size_t residentBytes = 0;   ///< bytes held by the sets in memory; changed under the exclusive lock
+    mutable size_t peakResidentBytes = 0;
+    size_t peakCountedBytes = 0;
+    std::atomic<unsigned> clock{0};     ///< advanced by checkpoint
+    unsigned long spills = 0;
+    mutable unsigned long refaults = 0;
+};
+
+#endif //ANSWERS_POINTSTOTABLE_H
@@ -0,0 +1,302 @@
+/**
+ * ResultStore.cpp
+ * @author kisslune
+ */
+
+#include "ResultStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+const char MAGIC[8] = {'A', '5', 'P', 'T', 'S', 'B', 'I', 'N'};
+
+/// Bytes of the longest varint of a 32-bit ID; the last one holds 4 bits
+constexpr unsigned MAX_VARINT_BYTES = 5;
+
+/// Append a sorted ID list to a payload section
+void encode(const std::vector<unsigned> &ids, bool compress, std::vector<uint8_t> &out)
+{
+    if (!compress)
+    {
+        auto pos = out.size();
+        out.resize(pos + ids.size() * sizeof(uint32_t));
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            uint32_t id = ids[i];
+            std::memcpy(&out[pos + i * sizeof(uint32_t)], &id, sizeof(uint32_t));
+        }
+        return;
+    }
+
+    unsigned prev = 0;
+    for (auto id : ids)
+    {
+        unsigned gap = id - prev;
+        prev = id;
+        while (gap >= 0x80)
+        {
+            out.push_back((uint8_t) (gap | 0x80));
+            gap >>= 7;
+        }
+        out.push_back((uint8_t) gap);
+    }
+}
+
+inline void pad(std::vector<uint8_t> &section)
+{ section.resize((section.size() + 7) & ~(size_t) 7, 0); }
+
+template<class T>
+inline void appendArray(std::vector<uint8_t> &file, const std::vector<T> &array)
+{
+    auto pos = file.size();
+    file.resize(pos + array.size() * sizeof(T));
+    if (!array.empty())
+        std::memcpy(&file[pos], array.data(), array.size() * sizeof(T));
+    pad(file);
+}
+
+}
+
+
+bool writeResultStore(const std::string &fname, const ResultStoreData &data, bool compress)
+{
+    unsigned numNodes = 0;
+    unsigned numObjs = 0;
+    for (auto &node : data.nodes)
+        numNodes = std::max(numNodes, node.first + 1);
+    for (auto &set : data.sets)
+    {
+        if (!set.empty())
+            numObjs = std::max(numObjs, set.back() + 1);
+    }
+
+    std::vector<uint32_t> nodeTable(numNodes, ResultStore::NOT_REPORTED);
+    for (auto &node : data.nodes)
+        nodeTable[node.first] = node.second;
+
+    std::vector<uint64_t> setOffsets;
+    std::vector<uint8_t> setPayload;
+    for (auto &set : data.sets)
+    {
+        setOffsets.push_back(setPayload.size());
+        encode(set, compress, setPayload);
+    }
+    setOffsets.push_back(setPayload.size());
+
+    // reverse index: nodes are visited in ascending order, so every list comes out sorted
+    std::vector<std::vector<unsigned>> pointers(numObjs);
+    for (unsigned node = 0; node < numNodes; ++node)
+    {
+        if (nodeTable[node] == ResultStore::NOT_REPORTED)
+            continue;
+        for (auto obj : data.sets[nodeTable[node]])
+            pointers[obj].push_back(node);
+    }
+    std::vector<uint64_t> objOffsets;
+    std::vector<uint8_t> objPayload;
+    for (auto &list : pointers)
+    {
+        objOffsets.push_back(objPayload.size());
+        encode(list, compress, objPayload);
+    }
+    objOffsets.push_back(objPayload.size());
+
+    ResultStoreHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = ResultStore::VERSION;
+    header.flags = compress ? ResultStore::FLAG_VARINT : 0;
+    header.numNodes = numNodes;
+    header.numSets = data.sets.size();
+    header.numObjs = numObjs;
+
+    std::vector<uint8_t> file(sizeof(header));
+    pad(file);
+    header.nodeTableOffset = file.size();
+    appendArray(file, nodeTable);
+    header.setOffsetsOffset = file.size();
+    appendArray(file, setOffsets);
+    header.setPayloadOffset = file.size();
+    appendArray(file, setPayload);
+    header.objOffsetsOffset = file.size();
+    appendArray(file, objOffsets);
+    header.objPayloadOffset = file.size();
+    appendArray(file, objPayload);
+    header.fileSize = file.size();
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    std::ofstream outFile(fname, std::ios::out | std::ios::binary);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return false;
+    }
+    outFile.write((const char *) file.data(), file.size());
+    return (bool) outFile;
+}
+
+
+ResultStore::~ResultStore()
+{
+    if (mapped)
+        munmap(mapped, mappedSize);
+}
+
+
+bool ResultStore::open(const std::string &fname)
+{
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "error opening " << fname << "!!\n";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ResultStoreHeader))
+    {
+        std::cerr << fname << " is too small to be a result file\n";
+        ::close(fd);
+        return false;
+    }
+    mappedSize = st.st_size;
+    mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        mapped = nullptr;
+        std::cerr << "error mapping " << fname << "!!\n";
+        return false;
+    }
+
+    auto base = (const uint8_t *) mapped;
+    header = (const ResultStoreHeader *) base;
+    if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->version != VERSION ||
+        header->fileSize != mappedSize)
+    {
+        std::cerr << fname << " is not a result file of version " << VERSION << "\n";
+        return false;
+    }
+
+    // the file may come from anywhere: check every offset and count before anything is read through them
+    auto corrupt = [&](const char *what) {
+        std::cerr << fname << " is corrupt: " << what << "\n";
+        return false;
+    };
+    auto fits = [&](uint64_t offset, uint64_t bytes) {
+        return offset >= sizeof(ResultStoreHeader) && offset % 8 == 0 && offset <= mappedSize &&
+               bytes <= mappedSize - offset;
+    };
+    if ((header->flags & ~FLAG_VARINT) != 0)
+        return corrupt("unknown flags");
+    if (header->numSets == 0)
+        return corrupt("no empty set");
+    if (!fits(header->nodeTableOffset, (uint64_t) header->numNodes * sizeof(uint32_t)))
+        return corrupt("node table out of the file");
+    if (!fits(header->setOffsetsOffset, ((uint64_t) header->numSets + 1) * sizeof(uint64_t)))
+        return corrupt("set offsets out of the file");
+    if (!fits(header->objOffsetsOffset, ((uint64_t) header->numObjs + 1) * sizeof(uint64_t)))
+        return corrupt("object offsets out of the file");
+
+    nodeTable = (const uint32_t *) (base + header->nodeTableOffset);
+    setOffsets = (const uint64_t *) (base + header->setOffsetsOffset);
+    setPayload = base + header->setPayloadOffset;
+    objOffsets = (const uint64_t *) (base + header->objOffsetsOffset);
+    objPayload = base + header->objPayloadOffset;
+
+    // offsets grow from 0 to the end of their payload, which lies in the file; plain payloads hold whole IDs
+    auto validOffsets = [&](const uint64_t *offsets, uint32_t count, uint64_t payloadOffset) {
+        if (offsets[0] != 0)
+            return false;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (offsets[i + 1] < offsets[i])
+                return false;
+            if (!(header->flags & FLAG_VARINT) && (offsets[i + 1] - offsets[i]) % sizeof(uint32_t) != 0)
+                return false;
+        }
+        return fits(payloadOffset, offsets[count]);
+    };
+    if (!validOffsets(setOffsets, header->numSets, header->setPayloadOffset))
+        return corrupt("bad set offsets");
+    if (!validOffsets(objOffsets, header->numObjs, header->objPayloadOffset))
+        return corrupt("bad object offsets");
+    for (uint32_t node = 0; node < header->numNodes; ++node)
+    {
+        if (nodeTable[node] != NOT_REPORTED && nodeTable[node] >= header->numSets)
+            return corrupt("node with a set out of range");
+    }
+    return true;
+}
+
+
+std::vector<unsigned> ResultStore::pointsTo(unsigned node) const
+{
+    std::vector<unsigned> objs;
+    if (!isReported(node))
+        return objs;
+    auto set = nodeTable[node];
+    if (!decode(setPayload + setOffsets[set], setPayload + setOffsets[set + 1], objs))
+    {
+        std::cerr << "malformed payload of set " << set << "\n";
+        objs.clear();
+    }
+    return objs;
+}
+
+
+std::vector<unsigned> ResultStore::pointedBy(unsigned obj) const
+{
+    std::vector<unsigned> nodes;
+    if (obj >= header->numObjs)
+        return nodes;
+    if (!decode(objPayload + objOffsets[obj], objPayload + objOffsets[obj + 1], nodes))
+    {
+        std::cerr << "malformed payload of object " << obj << "\n";
+        nodes.clear();
+    }
+    return nodes;
+}
+
+
+bool ResultStore::decode(const uint8_t *begin, const uint8_t *end, std::vector<unsigned> &out) const
+{
+    if (!(header->flags & FLAG_VARINT))
+    {
+        out.resize((end - begin) / sizeof(uint32_t));
+        if (!out.empty())
+            std::memcpy(out.data(), begin, out.size() * sizeof(uint32_t));
+        return true;
+    }
+
+    unsigned prev = 0;
+    while (begin < end)
+    {
+        unsigned gap = 0;
+        unsigned length = 0;
+        uint8_t byte;
+        do
+        {
+            // a varint cut by the end of the payload, or longer than a 32-bit gap needs
+            if (begin == end || length == MAX_VARINT_BYTES)
+                return false;
+            byte = *begin++;
+            gap |= (unsigned) (byte & 0x7f) << (7 * length);
+            length++;
+        } while (byte & 0x80);
+        if (length == MAX_VARINT_BYTES && (byte >> 4) != 0)
+            return false;
+        prev += gap;
+        out.push_back(prev);
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+/**
+ * ResultStore.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_RESULTSTORE_H
+#define ANSWERS_RESULTSTORE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Binary points-to result file, meant to be memory-mapped and queried in place.
+ *
+ * Layout (little-endian, sections 8-byte aligned):
+ *   ResultStoreHeader
+ *   node table     uint32[numNodes]      set index of each node, or NOT_REPORTED
+ *   set offsets    uint64[numSets + 1]   byte offsets of the set payloads; set 0 is the empty set
+ *   set payloads                         members of each distinct set, stored once
+ *   object offsets uint64[numObjs + 1]   byte offsets of the reverse (pointed-by) lists
+ *   object payloads                      reported nodes whose set holds each object
+ * A payload is a sorted list of uint32 IDs, or with FLAG_VARINT the first ID and then the gaps between
+ * consecutive IDs, each as an LEB128 varint.
+ */
+
+struct ResultStoreHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t numNodes;
+    uint32_t numSets;
+    uint32_t numObjs;
+    uint32_t reserved;
+    uint64_t nodeTableOffset;
+    uint64_t setOffsetsOffset;
+    uint64_t setPayloadOffset;
+    uint64_t objOffsetsOffset;
+    uint64_t objPayloadOffset;
+    uint64_t fileSize;
+};
+
+/// Content of a result file before encoding
+struct ResultStoreData
+{
+    std::vector<std::pair<unsigned, unsigned>> nodes;   ///< (reported node, index into sets)
+    std::vector<std::vector<unsigned>> sets;            ///< distinct sets with sorted members; sets[0] is empty
+};
+
+/// Write data to fname; with compress, payloads are varint/delta encoded
+bool writeResultStore(const std::string &fname, const ResultStoreData &data, bool compress);
+
+
+/**
+ * Read-only view of a memory-mapped result file
+ */
+class ResultStore
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t FLAG_VARINT = 1;
+    static constexpr uint32_t NOT_REPORTED = 0xffffffff;
+
+    ResultStore() = default;
+    ResultStore(const ResultStore &) = delete;
+    ResultStore &operator=(const ResultStore &) = delete;
+    ~ResultStore();
+
+    /// Map fname and check its header, sections and node table; prints the reason and returns false on failure
+    bool open(const std::string &fname);
+
+    inline const ResultStoreHeader &getHeader() const
+    { return *header; }
+
+    /// Check whether node has an entry in the result
+    inline bool isReported(unsigned node) const
+    { return node < header->numNodes && nodeTable[node] != NOT_REPORTED; }
+
+    /// Objects that node points to, in ascending order
+    std::vector<unsigned> pointsTo(unsigned node) const;
+    /// Reported nodes that point to obj, in ascending order
+    std::vector<unsigned> pointedBy(unsigned obj) const;
+
+private:
+    /// Decode the payload between two byte offsets of a section; false if a varint is cut or too long
+    bool decode(const uint8_t *begin, const uint8_t *end, std::vector<unsigned> &out) const;
+
+    void *mapped = nullptr;
+    size_t mappedSize = 0;
+    const ResultStoreHeader *header = nullptr;
+    const uint32_t *nodeTable = nullptr;
+    const uint64_t *setOffsets = nullptr;
+    const uint8_t *setPayload = nullptr;
+    const uint64_t *objOffsets = nullptr;
+    const uint8_t *objPayload = nullptr;
+};
+
+#endif //ANSWERS_RESULTSTORE_H
@@ -0,0 +1,80 @@
+/**
+ * SpillFile.cpp
+ * @author kisslune
+ */
+
+#include "SpillFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SpillFile::~SpillFile()
+{
+    if (mapped)
+        munmap(mapped, capacity);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+
+bool SpillFile::open(const std::string &dir)
+{
+    std::string path = dir + "/andersen-spill-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    fd = mkstemp(name.data());
+    if (fd < 0)
+    {
+        std::cerr << "error opening " << path << "!!\n";
+        return false;
+    }
+    unlink(name.data());
+    return grow(1 << 20);
+}
+
+
+uint64_t SpillFile::append(const std::vector<uint8_t> &bytes)
+{
+    if (used + bytes.size() > capacity && !grow(std::max(capacity * 2, used + bytes.size())))
+        return NO_OFFSET;
+    std::memcpy((uint8_t *) mapped + used, bytes.data(), bytes.size());
+    uint64_t offset = used;
+    used += bytes.size();
+    return offset;
+}
+
+
+void SpillFile::dropPages(uint64_t offset)
+{
+    if (!mapped || offset >= used)
+        return;
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t begin = offset / page * page;
+    madvise((uint8_t *) mapped + begin, used - begin, MADV_DONTNEED);
+}
+
+
+bool SpillFile::grow(uint64_t minCapacity)
+{
+    if (ftruncate(fd, minCapacity) != 0)
+    {
+        std::cerr << "error growing the spill file to " << minCapacity << " bytes!!\n";
+        return false;
+    }
+    void *remapped = mmap(nullptr, minCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (remapped == MAP_FAILED)
+    {
+        std::cerr << "error mapping the spill file!!\n";
+        return false;
+    }
+    if (mapped)
+        munmap(mapped, capacity);
+    mapped = remapped;
+    capacity = minCapacity;
+    return true;
+}
@@ -0,0 +1,63 @@
+/**
+ * SpillFile.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_SPILLFILE_H
+#define ANSWERS_SPILLFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only backing file of spilled points-to sets, memory-mapped for reading.
+ *
+ * The file is created in a directory and unlinked right away, so it goes away with the process. It grows by
+ * doubling; growing remaps it, so a pointer returned by data() is only valid until the next append.
+ */
+class SpillFile
+{
+public:
+    SpillFile() = default;
+    SpillFile(const SpillFile &) = delete;
+    SpillFile &operator=(const SpillFile &) = delete;
+    ~SpillFile();
+
+    /// Create the file in dir; prints the reason and returns false on failure
+    bool open(const std::string &dir);
+
+    inline bool isOpen() const
+    { return fd >= 0; }
+
+    /**
+     * Append bytes to the file
+     * @return the offset of the bytes, or NO_OFFSET if the file cannot grow
+     */
+    uint64_t append(const std::vector<uint8_t> &bytes);
+
+    /// Bytes at offset, as appended
+    inline const uint8_t *data(uint64_t offset) const
+    { return (const uint8_t *) mapped + offset; }
+
+    /// Take the pages of the bytes appended from offset on out of the resident memory of the process; the bytes
+    /// stay in the file
+    void dropPages(uint64_t offset);
+
+    /// Bytes appended so far
+    inline uint64_t size() const
+    { return used; }
+
+    static constexpr uint64_t NO_OFFSET = ~(uint64_t) 0;
+
+private:
+    bool grow(uint64_t minCapacity);
+
+    int fd = -1;
+    void *mapped = nullptr;
+    uint64_t capacity = 0;
+    uint64_t used = 0;
+};
+
+#endif //ANSWERS_SPILLFILE_H
@@ -0,0 +1,245 @@
+/**
+ * Steensgaard.cpp
+ * @author kisslune
+ */
+
+#include "Steensgaard.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+void Steensgaard::analyze()
+{
+    unsigned maxId = 0;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+        maxId = std::max(maxId, (unsigned) it->first);
+    parent.resize(maxId + 1);
+    std::iota(parent.begin(), parent.end(), 0);
+    rank.assign(maxId + 1, 0);
+    pointee.assign(maxId + 1, NO_NODE);
+
+    // p = &o: o is in the class p points to; p = q: p and q point to the same class;
+    // q = *p: q points to what p's pointees point to; *p = q: p's pointees point to what q points to
+    std::vector<unsigned> objects;
+    std::vector<unsigned> gepPointees;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        SVF::ConstraintNode *node = it->second;
+        for (auto edge : node->getAddrInEdges())
+        {
+            join(pointeeOf(edge->getDstID()), edge->getSrcID());
+            objects.push_back(edge->getSrcID());
+        }
+        for (auto edge : node->getCopyOutEdges())
+            join(pointeeOf(edge->getSrcID()), pointeeOf(edge->getDstID()));
+        for (auto edge : node->getLoadOutEdges())
+            join(pointeeOf(pointeeOf(edge->getSrcID())), pointeeOf(edge->getDstID()));
+        for (auto edge : node->getStoreOutEdges())
+            join(pointeeOf(edge->getSrcID()), pointeeOf(pointeeOf(edge->getDstID())));
+        for (auto edge : node->getGepOutEdges())
+        {
+            // field-insensitive: the fields of an object are the object
+            unsigned target = pointeeOf(edge->getSrcID());
+            join(target, pointeeOf(edge->getDstID()));
+            gepPointees.push_back(target);
+        }
+    }
+
+    // from here on the classes are fixed: point every class straight at its root
+    for (unsigned c = 0; c < parent.size(); ++c)
+        parent[c] = find(c);
+
+    fieldBearing.assign(parent.size(), false);
+    for (auto c : gepPointees)
+        fieldBearing[parent[c]] = true;
+
+    std::sort(objects.begin(), objects.end());
+    objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+    numObjects = objects.size();
+    objectsOf.assign(parent.size(), {});
+    for (auto o : objects)
+        objectsOf[parent[o]].push_back(o);
+
+    // components: a class is linked to the class it points to
+    std::vector<unsigned> componentParent(parent.size());
+    std::iota(componentParent.begin(), componentParent.end(), 0);
+    auto findComponent = [&](unsigned c) {
+        while (componentParent[c] != c)
+            c = componentParent[c] = componentParent[componentParent[c]];
+        return c;
+    };
+    for (unsigned c = 0; c < parent.size(); ++c)
+    {
+        if (parent[c] == c && pointee[c] != NO_NODE)
+            componentParent[findComponent(c)] = findComponent(parent[pointee[c]]);
+    }
+
+    classOf.assign(maxId + 1, NO_NODE);
+    componentOf.assign(maxId + 1, NO_NODE);
+    std::vector<unsigned> componentIds(parent.size(), NO_NODE);
+    std::vector<unsigned> componentSizes;
+    std::vector<bool> seenClass(parent.size(), false);
+    for (auto it = consg->begin(); it != consg->end(); it++)
+    {
+        unsigned id = it->first;
+        classOf[id] = parent[id];
+        if (!seenClass[parent[id]])
+        {
+            seenClass[parent[id]] = true;
+            numClasses++;
+        }
+
+        unsigned &component = componentIds[findComponent(parent[id])];
+        if (component == NO_NODE)
+        {
+            component = componentSizes.size();
+            componentSizes.push_back(0);
+        }
+        componentOf[id] = component;
+        componentSizes[component]++;
+    }
+    numComponents = componentSizes.size();
+    largestComponent = componentSizes.empty() ? 0 : *std::max_element(componentSizes.begin(), componentSizes.end());
+}
+
+
+const std::vector<unsigned> &Steensgaard::pointsTo(unsigned id) const
+{
+    static const std::vector<unsigned> empty;
+    unsigned target = getPointeeClass(id);
+    return target == NO_NODE ? empty : objectsOf[target];
+}
+
+
+unsigned Steensgaard::getPointeeClass(unsigned id) const
+{
+    if (id >= classOf.size() || classOf[id] == NO_NODE || pointee[classOf[id]] == NO_NODE)
+        return NO_NODE;
+    return parent[pointee[classOf[id]]];
+}
+
+
+unsigned Steensgaard::getSingleTarget(unsigned id) const
+{
+    unsigned target = getPointeeClass(id);
+    if (target == NO_NODE || fieldBearing[target] || objectsOf[target].size() != 1)
+        return NO_NODE;
+    return objectsOf[target].front();
+}
+
+
+unsigned Steensgaard::find(unsigned c)
+{
+    while (parent[c] != c)
+        c = parent[c] = parent[parent[c]];
+    return c;
+}
+
+
+unsigned Steensgaard::pointeeOf(unsigned c)
+{
+    c = find(c);
+    if (pointee[c] == NO_NODE)
+    {
+        unsigned target = newClass();
+        pointee[c] = target;
+    }
+    return find(pointee[c]);
+}
+
+
+void Steensgaard::join(unsigned a, unsigned b)
+{
+    // iterative, as joining two classes joins the chains of classes they point to
+    std::vector<std::pair<unsigned, unsigned>> pending = {{a, b}};
+    while (!pending.empty())
+    {
+        unsigned x = find(pending.back().first);
+        unsigned y = find(pending.back().second);
+        pending.pop_back();
+        if (x == y)
+            continue;
+
+        if (rank[x] < rank[y])
+            std::swap(x, y);
+        else if (rank[x] == rank[y])
+            rank[x]++;
+        parent[y] = x;
+
+        if (pointee[y] != NO_NODE)
+        {
+            if (pointee[x] == NO_NODE)
+                pointee[x] = pointee[y];
+            else
+                pending.emplace_back(pointee[x], pointee[y]);
+        }
+    }
+}
+
+
+unsigned Steensgaard::newClass()
+{
+    parent.push_back(parent.size());
+    rank.push_back(0);
+    pointee.push_back(NO_NODE);
+    return parent.size() - 1;
+}
+
+
+void Steensgaard::dumpResult()
+{
+    std::string fname = SVF::PAG::getPAG()->getModuleIdentifier() + ".res.txt";
+    std::ofstream outFile(fname, std::ios::out);
+    if (!outFile)
+    {
+        std::cout << "error opening " + fname + "!!\n";
+        return;
+    }
+
+    std::vector<unsigned> ids;
+    for (auto it = consg->begin(); it != consg->end(); it++)
+        ids.push_back(it->first);
+    std::sort(ids.begin(), ids.end());
+    for (auto pointer : ids)
+    {
+        auto &objs = pointsTo(pointer);
+        if (objs.empty())
+            continue;
+        outFile << pointer << " points to: {";
+        for (auto pointee : objs)
+            outFile << pointee << ", ";
+        outFile << "}\n";
+    }
+}
+
+
+void Steensgaard::printStats()
+{
+    unsigned singleTargets = 0;
+    for (unsigned id = 0; id < classOf.size(); ++id)
+    {
+        if (getSingleTarget(id) != NO_NODE)
+            singleTargets++;
+    }
+
+    SVF::SVFUtil::outs() << "################ (Steensgaard statistics) ################\n";
+    SVF::SVFUtil::outs() << "Classes\t" << numClasses << "\n";
+    SVF::SVFUtil::outs() << "Objects\t" << numObjects << "\n";
+    SVF::SVFUtil::outs() << "Components\t" << numComponents << "\n";
+    SVF::SVFUtil::outs() << "LargestComponent\t" << largestComponent << "\n";
+    SVF::SVFUtil::outs() << "SingleTargetNodes\t" << singleTargets << "\n";
+    SVF::SVFUtil::outs() << "##########################################################\n";
+}
+
+
+bool Steensgaard::dumpReport(const std::string &fname, const PhaseProfile &profile) const
+{
+    return profile.writeJson(fname, {
+            {"classes", numClasses},
+            {"objects", numObjects},
+            {"components", numComponents},
+            {"largest_component", largestComponent},
+    });
+}
@@ -0,0 +1,94 @@
+/**
+ * Steensgaard.h
+ * @author kisslune
+ */
+
+#ifndef ANSWERS_STEENSGAARD_H
+#define ANSWERS_STEENSGAARD_H
+
+#include "SVF-LLVM/SVFIRBuilder.h"
+#include "PhaseProfile.h"
+
+#include <climits>
+#include <vector>
+
+/**
+ * Unification-based (Steensgaard) points-to analysis over a constraint graph.
+ *
+ * Nodes are grouped into classes of locations, and each class points to at most one class. A constraint
+ * joins classes instead of adding an inclusion, so one pass over the edges with union-find reaches the
+ * result in almost linear time. Geps are field-insensitive: the target of a gep points to the class its
+ * source points to, and a field object is represented by its base object.
+ *
+ * The result over-approximates the one of Andersen: the set of a node is every object in the class it points
+ * to, except that field objects are not named. Classes reached through a gep are marked, so that no bound is
+ * derived from them.
+ */
+class Steensgaard
+{
+public:
+    static constexpr unsigned NO_NODE = UINT_MAX;
+
+    explicit Steensgaard(SVF::ConstraintGraph *consg) :
+            consg(consg)
+    {}
+
+    /// Join the classes of all constraints of the graph
+    void analyze();
+
+    /// Objects that id may point to, in ascending order
+    const std::vector<unsigned> &pointsTo(unsigned id) const;
+
+    /// Class of locations of id, NO_NODE if id is not a node of the graph
+    inline unsigned getClass(unsigned id) const
+    { return id < classOf.size() ? classOf[id] : NO_NODE; }
+
+    /// Class that id points to, whose objects are pointsTo(id); NO_NODE if id points to nothing
+    unsigned getPointeeClass(unsigned id) const;
+
+    /// The object id points to if Andersen's set of id cannot hold anything else, NO_NODE otherwise
+    unsigned getSingleTarget(unsigned id) const;
+
+    /**
+     * Component of id. Nodes of different components never exchange objects, neither along constraint
+     * edges nor along the copy edges derived from loads and stores.
+     */
+    inline unsigned getComponent(unsigned id) const
+    { return id < componentOf.size() ? componentOf[id] : NO_NODE; }
+
+    inline unsigned getNumComponents() const
+    { return numComponents; }
+
+    /// Write the set of every node that points to something to <module>.res.txt
+    void dumpResult();
+    void printStats();
+    /// Write the phases of profile and the counters of the analysis to fname as JSON
+    bool dumpReport(const std::string &fname, const PhaseProfile &profile) const;
+
+private:
+    unsigned find(unsigned c);
+    /// Class that c points to, created empty if c points to nothing yet
+    unsigned pointeeOf(unsigned c);
+    /// Merge two classes and, recursively, the classes they point to
+    void join(unsigned a, unsigned b);
+    unsigned newClass();
+
+    SVF::ConstraintGraph *consg;
+
+    // classes under construction: one per node ID, then the classes created by pointeeOf
+    std::vector<unsigned> parent;
+    std::vector<unsigned char> rank;
+    std::vector<unsigned> pointee;      ///< class -> class it points to, NO_NODE if none
+
+    // result, indexed by node ID or class root
+    std::vector<unsigned> classOf;      ///< node -> root of its class
+    std::vector<std::vector<unsigned>> objectsOf;   ///< class root -> objects in the class, ascending
+    std::vector<bool> fieldBearing;     ///< class root -> reached through a gep, so it may hold field objects
+    std::vector<unsigned> componentOf;  ///< node -> component
+    unsigned numComponents = 0;
+    unsigned numObjects = 0;
+    unsigned numClasses = 0;
+    unsigned largestComponent = 0;      ///< nodes in the largest component
+};
+
+#endif //ANSWERS_STEENSGAARD_H
@@ -0,0 +1,78 @@
+#!/bin/bash
+# Save, modify and load over the Test-Cases: the result of an incremental run must be the one of a run from
+# scratch, both when the program gains constraints and when it loses some (the snapshot is then rejected, as is
+# one with an edge of unknown kind).
+#
+#   incremental.sh <andersen> <clang> <Test-Cases dir> <work dir> [andersen options...]
+#
+# Exits with 77 (skipped) if clang cannot be run.
+
+ANDERSEN=$(realpath "$1")
+CLANG="$2"
+TEST_DIR=$(realpath "$3")
+WORK_DIR="$4"
+shift 4
+
+if ! "$CLANG" --version > /dev/null 2>&1; then
+    echo "clang not found: $CLANG"
+    exit 77
+fi
+mkdir -p "$WORK_DIR" && cd "$WORK_DIR" || exit 1
+
+# appended to each program: a function with its own constraints, numbered after those of the program
+EXTRA='
+void andersen_incremental_extra(void)
+{
+    int x, y;
+    int *p = &x, *q = &y;
+    int **pp = &p;
+    *pp = q;
+    q = *pp;
+}'
+
+fail=0
+for cfile in "$TEST_DIR"/*.c; do
+    name=$(basename "$cfile" .c)
+    cp "$cfile" "$name.c"
+    { cat "$cfile"; echo "$EXTRA"; } > "$name.more.c"
+    "$CLANG" -O0 -emit-llvm -c "$name.c" -o "$name.bc" && "$CLANG" -O0 -emit-llvm -c "$name.more.c" -o "$name.more.bc"
+    if [ $? -ne 0 ]; then
+        echo "FAIL $name: cannot compile"
+        fail=1
+        continue
+    fi
+
+    # from scratch, saving the state of both versions
+    "$ANDERSEN" "$@" -andersen-save="$name.snap" "$name.bc" > /dev/null 2>&1 &&
+        mv "$name.bc.res.txt" "$name.scratch.txt" &&
+        "$ANDERSEN" "$@" -andersen-save="$name.more.snap" "$name.more.bc" > /dev/null 2>&1 &&
+        mv "$name.more.bc.res.txt" "$name.more.scratch.txt"
+    if [ $? -ne 0 ]; then
+        echo "FAIL $name: andersen failed"
+        fail=1
+        continue
+    fi
+
+    # constraints added: continue from the snapshot of the smaller program
+    if ! "$ANDERSEN" "$@" -andersen-load="$name.snap" -andersen-check-incremental "$name.more.bc" \
+            > "$name.more.log" 2>&1 || ! diff -q "$name.more.bc.res.txt" "$name.more.scratch.txt" > /dev/null; then
+        echo "FAIL $name: added constraints"
+        fail=1
+    fi
+
+    # constraints removed: the snapshot of the larger program must not be used
+    if ! "$ANDERSEN" "$@" -andersen-load="$name.more.snap" "$name.bc" > "$name.log" 2>&1 ||
+            ! grep -q "solving from scratch" "$name.log" || ! diff -q "$name.bc.res.txt" "$name.scratch.txt" > /dev/null; then
+        echo "FAIL $name: removed constraints"
+        fail=1
+    fi
+
+    # an edge of unknown kind: the snapshot must not be used either
+    sed '0,/^edge a /s//edge x /' "$name.snap" > "$name.bad.snap"
+    if ! "$ANDERSEN" "$@" -andersen-load="$name.bad.snap" "$name.bc" > "$name.log" 2>&1 ||
+            ! grep -q "solving from scratch" "$name.log" || ! diff -q "$name.bc.res.txt" "$name.scratch.txt" > /dev/null; then
+        echo "FAIL $name: unknown edge kind"
+        fail=1
+    fi
+done
+exit $fail
@@ -0,0 +1,234 @@
+#!/bin/bash
+# Run andersen over the Test-Cases with each option combination and compare with the checked-in results.
+# The default options and those in EXACT must give the result files byte for byte; the options in RENUMBERED
+# create field objects in another order, so their results are compared after naming each field object by its
+# base object and offset, as listed in the snapshot of the run. The parallel solver numbers them the same way
+# for any number of threads, so its runs must also agree with each other byte for byte. Demand-driven answers
+# must be the sets of the result file, alias answers must be whether those sets intersect, and the JSON report
+# must hold all phases and counters. Last, a batch
+# run over all Test-Cases must give each module the files of its own run.
+#
+#   results.sh <andersen> <andersen-query> <Test-Cases dir> <work dir>
+
+ANDERSEN=$(realpath "$1")
+QUERY=$(realpath "$2")
+TEST_DIR=$(realpath "$3")
+WORK_DIR="$4"
+
+EXACT=("-andersen-simd=scalar" "-andersen-memory-budget=4K")
+RENUMBERED=("-andersen-wl=lifo" "-andersen-wl=lrf" "-andersen-wl=topo" "-andersen-wl=wave"
+            "-andersen-engine=steens-andersen" "-andersen-threads=4")
+# what -andersen-report must hold: the phases of a default run in order, and every counter once
+PHASES="buildSVFModule buildSVFIR buildConstraintGraph dumpConstraintGraph mergePointerEquivalents solve dumpResult"
+COUNTERS=(worklist_pops unions changed_unions derived_copy_edges duplicate_copy_edges field_objects field_memo_hits
+          collapsed_objects alias_queries alias_cache_hits interned_sets collected_sets union_memo_hits
+          union_memo_misses spilled_sets refaulted_sets spill_file_bytes peak_resident_set_bytes peak_budgeted_bytes
+          parallel_rounds demand_nodes steensgaard_components final_node_unions non_empty_sets largest_set
+          average_set_size)
+
+mkdir -p "$WORK_DIR" && cd "$WORK_DIR" || exit 1
+
+# points-to pairs of a result file, one per line and sorted, with the field objects of a snapshot named
+canonical()
+{
+    awk 'NR == FNR {
+             if ($1 == "field")
+                 name[$2] = (($3 in name) ? name[$3] : $3) "+" $4
+             next
+         }
+         {
+             key = ($1 in name) ? name[$1] : $1
+             members = $0
+             sub(/^[^{]*\{/, "", members)
+             sub(/\}.*$/, "", members)
+             n = split(members, ids, /, */)
+             empty = 1
+             for (i = 1; i <= n; i++)
+             {
+                 if (ids[i] == "")
+                     continue
+                 print key " -> " ((ids[i] in name) ? name[ids[i]] : ids[i])
+                 empty = 0
+             }
+             if (empty)
+                 print key " ->"
+         }' "$1" "$2" | sort
+}
+
+# points-to pairs of the nodes below the first field object $1 (all nodes if it is empty), in a result file
+# or in the answers of -andersen-demand; each field object is named "field", as the numbering of a demand run
+# follows the order in which the queries need them
+fieldsNamed()
+{
+    awk -v first="$1" '/ points to: \{/ {
+             if (first != "" && $1 + 0 >= first + 0)
+                 next
+             members = $0
+             sub(/^[^{]*\{/, "", members)
+             sub(/\}.*$/, "", members)
+             n = split(members, ids, /, */)
+             empty = 1
+             for (i = 1; i <= n; i++)
+             {
+                 if (ids[i] == "")
+                     continue
+                 print $1 " -> " ((first != "" && ids[i] + 0 >= first + 0) ? "field" : ids[i])
+                 empty = 0
+             }
+             if (empty)
+                 print $1 " ->"
+         }' "$2" | sort
+}
+
+# "p q MayAlias" or "p q NoAlias" for every two nodes p < q of a result file, as their sets intersect or not
+aliasAnswers()
+{
+    awk '/ points to: \{/ {
+             node[++n] = $1
+             members = $0
+             sub(/^[^{]*\{/, "", members)
+             sub(/\}.*$/, "", members)
+             m = split(members, ids, /, */)
+             for (i = 1; i <= m; i++)
+                 if (ids[i] != "")
+                     pointsTo[n, ids[i]] = 1
+             objects[n] = members
+         }
+         END {
+             for (i = 1; i <= n; i++)
+                 for (j = 1; j <= n; j++)
+                 {
+                     if (node[i] + 0 >= node[j] + 0)
+                         continue
+                     alias = 0
+                     m = split(objects[i], ids, /, */)
+                     for (k = 1; k <= m && !alias; k++)
+                         alias = ids[k] != "" && ((j, ids[k]) in pointsTo)
+                     print node[i] " " node[j] (alias ? " MayAlias" : " NoAlias")
+                 }
+         }' "$1" | sort
+}
+
+# value of the counter $1 in the JSON report $2
+counter()
+{
+    sed -n "s/^    \"$1\": \([0-9.e+-]*\),\?$/\1/p" "$2"
+}
+
+# check the JSON report $1 of a default run against its result file $2 and snapshot $3
+checkReport()
+{
+    local phases key
+    phases=$(grep -o '"name": "[A-Za-z]*", "wall_s": [0-9.e+-]*, "cpu_s": [0-9.e+-]*, "peak_rss_kb": [0-9]*}' "$1" |
+                 cut -d'"' -f4 | paste -sd' ')
+    [ "$phases" = "$PHASES" ] && grep -q '^  "peak_rss_kb": [0-9]*,$' "$1" && grep -q '^  "counters": {$' "$1" ||
+        return 1
+    for key in "${COUNTERS[@]}"; do
+        [ "$(grep -c "^    \"$key\": [0-9.e+-]*,\?$" "$1")" = 1 ] || return 1
+    done
+
+    # the set counters describe the result file, and the field objects are those of the snapshot
+    [ "$(counter non_empty_sets "$1")" = "$(grep -vc '{}$' "$2")" ] &&
+        [ "$(counter largest_set "$1")" = "$(awk -F, 'NF - 1 > max { max = NF - 1 } END { print max + 0 }' "$2")" ] &&
+        [ "$(counter field_objects "$1")" = "$(grep -c '^field ' "$3")" ] &&
+        [ "$(counter worklist_pops "$1")" -gt 0 ]
+}
+
+fail=0
+report()
+{
+    echo "FAIL $1 $2"
+    fail=1
+}
+
+for expected in "$TEST_DIR"/*.bc.res.txt; do
+    name=$(basename "$expected" .bc.res.txt)
+    # run on a copy named like the original, so that the module and its result file keep their names
+    cp "$TEST_DIR/$name.bc" "$name.bc"
+
+    # the default options give the checked-in file; their snapshot names its field objects
+    if ! "$ANDERSEN" -andersen-save="$name.snap" "$name.bc" > "$name.log" 2>&1 ||
+            ! cmp -s "$name.bc.res.txt" "$expected"; then
+        report "$name" "(default options)"
+        continue
+    fi
+    canonical "$name.snap" "$expected" > "$name.expected"
+
+    rm -f "$name.bc.res.txt"
+    if ! "$ANDERSEN" -andersen-report="$name.json" "$name.bc" > "$name.log" 2>&1 ||
+            ! cmp -s "$name.bc.res.txt" "$expected" || ! checkReport "$name.json" "$expected" "$name.snap"; then
+        report "$name" "-andersen-report"
+    fi
+
+    for options in "${EXACT[@]}"; do
+        rm -f "$name.bc.res.txt"
+        if ! "$ANDERSEN" $options "$name.bc" > "$name.log" 2>&1 || ! cmp -s "$name.bc.res.txt" "$expected"; then
+            report "$name" "$options"
+        fi
+    done
+
+    # the binary result file, plain and varint encoded, must hold the same sets
+    for options in "" "-andersen-varint"; do
+        rm -f "$name.bc.res.bin"
+        if ! "$ANDERSEN" -andersen-binary $options "$name.bc" > "$name.log" 2>&1 ||
+                ! "$QUERY" "$name.bc.res.bin" dump | cmp -s - "$expected"; then
+            report "$name" "-andersen-binary $options"
+        fi
+    done
+
+    for options in "${RENUMBERED[@]}"; do
+        rm -f "$name.bc.res.txt"
+        if ! "$ANDERSEN" $options -andersen-save="$name.other.snap" "$name.bc" > "$name.log" 2>&1 ||
+                ! canonical "$name.other.snap" "$name.bc.res.txt" | cmp -s - "$name.expected"; then
+            report "$name" "$options"
+        fi
+    done
+
+    cp "$name.bc.res.txt" "$name.threads4.txt"
+    rm -f "$name.bc.res.txt"
+    if ! "$ANDERSEN" -andersen-threads=2 "$name.bc" > "$name.log" 2>&1 ||
+            ! cmp -s "$name.bc.res.txt" "$name.threads4.txt"; then
+        report "$name" "-andersen-threads=2"
+    fi
+
+    # demand-driven answers for every node of the result file but the field objects
+    first=$(awk '$1 == "field" && (min == "" || $2 + 0 < min) { min = $2 + 0 } END { print min }' "$name.snap")
+    nodes=$(awk -v first="$first" 'first == "" || $1 + 0 < first + 0 { printf "%s%s", sep, $1; sep = "," }' \
+                "$expected")
+    if ! "$ANDERSEN" -andersen-demand="$nodes" "$name.bc" > "$name.demand" 2> "$name.log" ||
+            ! cmp -s <(fieldsNamed "$first" "$name.demand") <(fieldsNamed "$first" "$expected"); then
+        report "$name" "-andersen-demand"
+    fi
+
+    # alias queries of every two nodes of the result file, and the alias pairs among all of them
+    aliasAnswers "$expected" > "$name.aliases"
+    queries=$(awk '{ printf "%s%s:%s", sep, $1, $2; sep = "," }' "$name.aliases")
+    all=$(awk '/ points to: \{/ { printf "%s%s", sep, $1; sep = "," }' "$expected")
+    if ! "$ANDERSEN" -andersen-alias="$queries" -andersen-alias-pairs="$all" "$name.bc" > "$name.alias" \
+                2> "$name.log" ||
+            ! cmp -s <(grep -E '^[0-9]+ [0-9]+ (MayAlias|NoAlias)$' "$name.alias" | sort) "$name.aliases" ||
+            ! cmp -s <(sed -n 's/^alias //p' "$name.alias" | sort) \
+                     <(sed -n 's/ MayAlias$//p' "$name.aliases" | sort); then
+        report "$name" "-andersen-alias"
+    fi
+done
+
+# all Test-Cases in one batch, three at a time: each module gets the result file of its own run
+rm -f manifest.txt batch.json.*
+for expected in "$TEST_DIR"/*.bc.res.txt; do
+    name=$(basename "$expected" .bc.res.txt)
+    rm -f "$name.bc.res.txt"
+    echo "$name.bc" >> manifest.txt
+done
+"$ANDERSEN" -andersen-batch=manifest.txt -andersen-jobs=3 -andersen-report=batch.json > batch.log 2>&1 ||
+    report batch "-andersen-batch (exit status)"
+index=0
+while read -r module; do
+    name=$(basename "$module" .bc)
+    if ! cmp -s "$module.res.txt" "$TEST_DIR/$name.bc.res.txt" ||
+            ! checkReport "batch.json.$index" "$module.res.txt" "$name.snap"; then
+        report "$name" "-andersen-batch"
+    fi
+    index=$((index + 1))
+done < manifest.txt
+exit $fail